@@ -26,8 +26,12 @@
 #define MAX_VFS_BLOCKS (MAX_INODE_BLOCKS*BLOCK_SIZE*8)
 
 // Modos posibles de un inodo
+// INODE_FLAG_EXTENTS comparte los 4 bits de tipo con los modos (un archivo con extents
+// tiene 0x9000): el tipo se prueba siempre bit a bit, (mode & INODE_MODE_X) == INODE_MODE_X,
+// nunca comparando mode & 0xF000 con un modo
 #define INODE_MODE_FILE 0x8000  // Archivo regular
 #define INODE_MODE_DIR  0x4000  // Directorio
+#define INODE_FLAG_EXTENTS 0x1000  // El mapa de bloques del nodo-I es una lista de extents
 
 #define DEFAULT_PERM 0640       // Permisos por defecto para nuevos archivos
 
@@ -58,8 +62,16 @@ struct superblock {
     uint32_t inode_start;   // Bloque de inicio de la tabla de inodos
     uint32_t bitmap_start;  // Bloque de inicio del bitmap de bloques de datos
     uint32_t data_start;    // Primer bloque de datos disponible
+    uint32_t next_free_inode; // Pista: no hay nodos-I libres antes de este (0 si no se conoce)
+    uint32_t atime_policy;  // Cuándo se actualiza el atime al leer (VFS_ATIME_*)
 };
 
+// Políticas de actualización del atime al leer un archivo, ver inode_read_data
+#define VFS_ATIME_STRICT 0    // En cada lectura (imágenes anteriores, con el campo en cero)
+#define VFS_ATIME_RELATIME 1  // Solo si no es posterior a mtime/ctime o tiene más de un día
+#define VFS_ATIME_NOATIME 2   // Nunca
+#define VFS_ATIME_LAZYTIME 3  // En cada lectura, pero solo en memoria hasta vfs_sync/vfs_close
+
 // Inodo: información sobre un archivo o directorio
 
 // Cantidad de punteros de bloque que caben en un bloque indirecto
@@ -68,6 +80,13 @@ struct superblock {
 // Cantidad de punteros de bloque en el nodo-I
 #define NUM_DIRECT_PTRS 7
 
+// Cantidad de bloques de datos alcanzables desde un bloque doble y triple indirecto
+#define NUM_DINDIRECT_PTRS (NUM_INDIRECT_PTRS * NUM_INDIRECT_PTRS)
+#define NUM_TINDIRECT_PTRS (NUM_DINDIRECT_PTRS * NUM_INDIRECT_PTRS)
+
+// Cantidad máxima de bloques de datos de un archivo (limitada por el campo blocks del nodo-I)
+#define MAX_FILE_BLOCKS UINT16_MAX
+
 struct inode {
     uint16_t mode;          //  2 4 bits de tipo y 12 bits de permisos, estilo Unix
     uint16_t uid;           //  2 UID del propietario
@@ -79,13 +98,39 @@ struct inode {
     uint32_t atime;         //  4 Último acceso (timestamp Unix)
     uint32_t mtime;         //  4 Última modificación
     uint32_t ctime;         //  4 Creación
-    uint8_t reserved[6];    //  8 Espacio reservado para alinear a 64 bytes
+    uint32_t dindirect;     //  4 Puntero a un bloque doble indirecto (antes reservado, en cero)
+    uint32_t tindirect;     //  4 Puntero a un bloque triple indirecto (antes reservado, en cero)
 };
 
 #define INODE_SIZE (sizeof(struct inode)) // Tamaño del nodo-I
 #define INODES_PER_BLOCK (BLOCK_SIZE / INODE_SIZE) // Cantidad de nodos-I en un bloque
 #define BITS_PER_BLOCK (BLOCK_SIZE * 8) // Cantidad de bits en un bloque
 
+// Extent: tramo de bloques contiguos de un archivo
+// En un nodo-I con INODE_FLAG_EXTENTS, direct[] e indirect guardan INLINE_EXTENTS extents
+// y dindirect apunta a un bloque con hasta EXTENTS_PER_BLOCK extents más.
+// Una lista de extents termina en el primero con len 0
+struct extent {
+    uint32_t start;  // Primer bloque del tramo en la imagen
+    uint32_t len;    // Cantidad de bloques
+};
+
+#define INLINE_EXTENTS ((NUM_DIRECT_PTRS + 1) / 2)
+#define EXTENTS_PER_BLOCK (BLOCK_SIZE / sizeof(struct extent))
+
+// Recorrido del mapa de bloques de un archivo en orden, por tramos contiguos,
+// ver block_iter_init y block_iter_next
+struct block_iter {
+    const char *image_path;
+    struct inode *in;
+    uint32_t index;                      // Próximo bloque del archivo a entregar
+    uint32_t table_first;                // Primer bloque del archivo que cubre table
+    uint32_t table_count;                // Cantidad de punteros válidos en table, 0 si ninguno
+    uint32_t table[NUM_INDIRECT_PTRS];   // Bloque de punteros de nivel 1 en uso
+    uint32_t extent_count;               // Cantidad de extents (si el nodo-I usa extents)
+    struct extent extents[INLINE_EXTENTS + EXTENTS_PER_BLOCK];
+};
+
 // Bloque de indirección: contiene punteros a bloques de datos
 struct indirect_block {
     uint32_t blocks[NUM_INDIRECT_PTRS];
@@ -99,38 +144,205 @@ struct dir_entry {
 
 #define DIR_ENTRIES_PER_BLOCK (BLOCK_SIZE / sizeof(struct dir_entry)) // Cantidad de entradas en un bloque
 
+// Cabecera de un directorio: se guarda en el nombre de la entrada "." (primera del bloque 0),
+// después del terminador, asi quien solo lee nombres sigue viendo "." (28 bytes en total)
+struct dir_header {
+    char dot[4];              // ".", completado con ceros
+    uint32_t index_inode;     // Nodo-I oculto con el índice hash de nombres, 0 si no tiene
+    uint32_t index_used;      // Posiciones ocupadas del índice
+    uint32_t index_deleted;   // Posiciones borradas del índice (se descartan al reconstruirlo)
+    uint32_t free_hint;       // Pista: antes de esta posición (DIR_LOC) no hay entradas libres
+    uint32_t tree_inode;      // Nodo-I oculto con el árbol B+ de nombres, 0 si no tiene
+    uint32_t bloom_inode;     // Nodo-I oculto con el filtro de Bloom de nombres, 0 si no tiene
+};
+
+// Posición de una entrada en un directorio: bloque del directorio * DIR_ENTRIES_PER_BLOCK + entrada
+#define DIR_LOC(block, slot) ((block) * DIR_ENTRIES_PER_BLOCK + (slot))
+
+// Recorrido de las entradas de un directorio en orden de nombre, por las hojas de su árbol,
+// ver dir_tree_iter_init y dir_tree_iter_next
+struct dir_tree_iter {
+    const char *image_path;
+    uint32_t tree_inode;      // Nodo-I oculto del árbol
+    struct inode tree;
+    uint32_t node;            // Hoja actual
+    uint32_t pos;             // Próximo registro de la hoja
+    uint8_t buf[BLOCK_SIZE];  // Contenido de la hoja actual
+};
+
+// Cantidad máxima de imágenes abiertas a la vez por un proceso
+#define VFS_MAX_OPEN_DEVS 4
+
+// Formas de acceder a la imagen
+#define VFS_BACKEND_PREAD 0 // pread/pwrite sobre el descriptor (por defecto)
+#define VFS_BACKEND_MMAP 1  // imagen completa mapeada en memoria con mmap
+
+// Capacidad por defecto del cache de bloques (en bloques), ver vfs_cache_set_capacity
+#define VFS_CACHE_DEFAULT_BLOCKS 256
+
+// Contadores del cache de bloques de una imagen
+struct vfs_cache_stats {
+    uint64_t hits;        // Bloques encontrados en el cache
+    uint64_t misses;      // Bloques que no estaban en el cache
+    uint64_t evictions;   // Bloques descartados para hacer lugar
+    uint64_t writebacks;  // Bloques sucios escritos en la imagen
+};
+
+struct block_cache; // Definida en block-cache.c
+
+// Profundidad de cola por defecto del motor asincrónico de lectura, ver vfs_aio_set_depth
+#define VFS_AIO_DEFAULT_DEPTH 32
+
+struct vfs_aio; // Definida en block-uring.c
+
+// Entradas del cache de nombres de cada imagen (potencia de 2), ver dentry-cache.c
+#define VFS_DCACHE_ENTRIES 1024
+
+// Contadores del cache de nombres de una imagen
+struct vfs_dcache_stats {
+    uint64_t hits;           // Nombres encontrados en el cache
+    uint64_t negative_hits;  // Nombres que el cache ya sabía que no existen
+    uint64_t misses;         // Nombres que hubo que buscar en el directorio
+};
+
+struct dentry_cache; // Definida en dentry-cache.c
+
+// Niveles de bloques de punteros: simple, doble y triple indirecto
+#define INDIRECT_LEVELS 3
+
+// Último bloque de punteros leído en un nivel, ver get_block_number_at
+struct indirect_cache {
+    uint32_t block;                     // Número del bloque guardado, 0 si ninguno
+    uint32_t ptrs[NUM_INDIRECT_PTRS];   // Contenido del bloque
+};
+
+// Tramo de bloques contiguos de la imagen, ver bitmap_alloc_run
+struct block_run {
+    uint32_t start;  // Primer bloque del tramo
+    uint32_t len;    // Cantidad de bloques
+};
+
+// Dispositivo de bloques abierto: la imagen se abre una sola vez por proceso
+// y todas las capas (superbloque, bitmap, nodos-I, directorio, datos) lo comparten
+struct vfs_dev {
+    char *path;    // Ruta de la imagen, NULL si la entrada está libre
+    int fd;        // Descriptor de la imagen, abierto una sola vez
+    int writable;  // 1 si la imagen se abrió para lectura y escritura
+    uint8_t *map;  // Imagen mapeada en memoria, NULL si se usa pread/pwrite
+    size_t map_size;  // Tamaño en bytes del mapeo
+    int map_dirty;    // 1 si se escribió en el mapeo desde el último msync
+    struct block_cache *cache;  // Cache de bloques, NULL si no se usa (o si está mapeada)
+    struct vfs_aio *aio;        // Motor de lecturas asincrónicas, se crea al usarlo por primera vez
+    struct superblock sb;       // Copia en memoria del superbloque, válida si sb_loaded
+    int sb_loaded;              // 1 si sb ya se leyó de la imagen (o se escribió)
+    int sb_dirty;               // 1 si sb cambió y falta escribirlo en la imagen
+    uint8_t *inode_map;         // Un bit por nodo-I (1 = ocupado), se arma al asignar el primero
+    struct indirect_cache ind_cache[INDIRECT_LEVELS];  // Un bloque de punteros por nivel
+    uint32_t *lazy_atime;       // atime pendiente de escribir por nodo-I (0 = ninguno), con lazytime
+    uint32_t lazy_count;        // Cantidad de nodos-I con atime pendiente
+    struct dentry_cache *dcache;  // Cache de nombres, se crea al usarlo por primera vez
+};
+
 // Funciones
 
 // read-write-block.c
 int read_block(const char *image_path, int block_number, void *buffer);
 int write_block(const char *image_path, int block_number, const void *buffer);
-int create_block_device(const char *image_path, int total_blocks, int block_size);
+int read_blocks(const char *image_path, const uint32_t *block_numbers, void *const *buffers, uint32_t count);
+int write_blocks(const char *image_path, const uint32_t *block_numbers, const void *const *buffers, uint32_t count);
+int create_block_device(const char *image_path, int total_blocks, int block_size, int sparse);
+struct vfs_dev *vfs_open(const char *image_path);
+int vfs_close(const char *image_path);
+int vfs_sync(const char *image_path);
+void vfs_set_backend(int backend);
+const uint8_t *block_ptr(const char *image_path, int block_number);
+int vfs_cache_stats(const char *image_path, struct vfs_cache_stats *stats);
+int dev_read_block(struct vfs_dev *dev, int block_number, void *buffer);
+int dev_write_block(struct vfs_dev *dev, int block_number, const void *buffer);
+int dev_pread_block(struct vfs_dev *dev, int block_number, void *buffer);
+int dev_pwrite_block(struct vfs_dev *dev, int block_number, const void *buffer);
+int dev_preadv_run(struct vfs_dev *dev, int first_block, void *const *buffers, uint32_t count);
+int dev_pwritev_run(struct vfs_dev *dev, int first_block, const void *const *buffers, uint32_t count);
+int dev_read_blocks(struct vfs_dev *dev, const uint32_t *block_numbers, void *const *buffers, uint32_t count);
+int dev_write_blocks(struct vfs_dev *dev, const uint32_t *block_numbers, const void *const *buffers, uint32_t count);
+
+// block-cache.c
+void vfs_cache_set_capacity(uint32_t blocks);
+struct block_cache *cache_create(void);
+void cache_destroy(struct block_cache *cache);
+void cache_get_stats(const struct block_cache *cache, struct vfs_cache_stats *stats);
+int cache_read(struct vfs_dev *dev, int block_number, void *buffer);
+int cache_write(struct vfs_dev *dev, int block_number, const void *buffer);
+int cache_contains(struct vfs_dev *dev, int block_number);
+int cache_lookup(struct vfs_dev *dev, int block_number, void *buffer);
+int cache_update(struct vfs_dev *dev, int block_number, const void *buffer);
+int cache_flush(struct vfs_dev *dev);
+
+// block-uring.c
+void vfs_aio_set_depth(uint32_t depth);
+struct vfs_aio *aio_create(struct vfs_dev *dev);
+void aio_destroy(struct vfs_aio *aio);
+struct vfs_aio *vfs_aio_get(const char *image_path);
+int vfs_aio_is_async(const struct vfs_aio *aio);
+uint32_t vfs_aio_depth(const struct vfs_aio *aio);
+int vfs_aio_submit_read(struct vfs_aio *aio, uint32_t block_number, void *buffer);
+int vfs_aio_kick(struct vfs_aio *aio);
+int vfs_aio_complete(struct vfs_aio *aio, int slot_index);
+int read_blocks_prefetch(const char *image_path, const uint32_t *block_numbers, void *const *buffers,
+                         uint32_t count);
+
+// dentry-cache.c
+int dcache_lookup(const char *image_path, uint32_t parent, const char *name, uint32_t *inode, uint16_t *mode);
+void dcache_store(const char *image_path, uint32_t parent, const char *name, uint32_t inode, uint16_t mode);
+void dcache_destroy(struct dentry_cache *dcache);
+int vfs_dcache_stats(const char *image_path, struct vfs_dcache_stats *stats);
 
 // superblock.c
 int init_superblock(const char *image_path, uint32_t total_blocks, uint32_t total_inodes);
 int read_superblock(const char *image_path, struct superblock *sb);
 int write_superblock(const char *image_path, struct superblock *sb);
+int superblock_flush(struct vfs_dev *dev);
 void print_superblock(const struct superblock *sb);
+int atime_policy_from_name(const char *name);
+const char *atime_policy_name(uint32_t policy);
 
 // inode.c
 int read_inode(const char *image_path, uint32_t inode_number, struct inode *in);
+int read_inodes(const char *image_path, const uint32_t *inode_numbers, struct inode *inodes, uint32_t count);
 int write_inode(const char *image_path, uint32_t inode_number, const struct inode *in);
+int inode_set_lazy_atime(const char *image_path, uint32_t inode_number, uint32_t atime);
+int inode_flush_lazy_atimes(struct vfs_dev *dev);
 int free_inode(const char *image_path, uint32_t inode_number);
-int get_block_number_at(const char *image_path, struct inode *in, uint16_t index);
+int get_block_number_at(const char *image_path, struct inode *in, uint32_t index);
+int block_iter_init(struct block_iter *it, const char *image_path, struct inode *in, uint32_t first_index);
+int block_iter_next(struct block_iter *it, uint32_t max_len, struct block_run *run);
+uint32_t inode_map_blocks(uint32_t nblocks);
+uint32_t inode_extra_map_blocks(const struct inode *in, uint32_t nblocks);
 int create_empty_file_in_free_inode(const char *image_path, uint16_t perms);
 int inode_append_block(const char *image_path, struct inode *in, uint32_t new_block_number);
+int inode_append_blocks(const char *image_path, struct inode *in, const uint32_t *blocks, uint32_t count);
 int inode_trunc_data(const char *image_path, struct inode *in);
 
 // read-write-data.c
 int inode_read_data(const char *image_path, uint32_t inode_number, void *data_buf, size_t len, size_t offset);
 int inode_write_data(const char *image_path, uint32_t inode_number, void *data_buf, size_t len, size_t offset);
+void vfs_set_atime_policy(int policy);
+int inode_update_atime(const char *image_path, uint32_t inode_number, struct inode *in);
 
 // rootdir.c
 int create_root_dir(const char *image_path);
+int create_dir(const char *image_path, uint32_t parent_inode, uint16_t perms);
+int free_dir(const char *image_path, uint32_t dir_inode);
 
 // bitmap.c
+// Los bloques libres estan siempre en cero: bitmap_free_blocks con zero_fill = 0 solo para
+// bloques que no se escribieron desde que se reservaron
 int bitmap_free_block(const char *image_path, uint32_t block_nbr);
+int bitmap_free_blocks(const char *image_path, const uint32_t *blocks, uint32_t count, int zero_fill);
 int bitmap_set_first_free(const char *image_path);
+int bitmap_find_first_zero(const uint8_t *bitmap, uint32_t nbytes);
+int bitmap_alloc_run(const char *image_path, uint32_t max_len, struct block_run *run);
+int bitmap_alloc_blocks(const char *image_path, uint32_t count, uint32_t *blocks);
 void print_bitmap_block(uint8_t *buffer, uint32_t size);
 
 // ls-func.c
@@ -141,8 +353,40 @@ const char *str_group(uint16_t gid);
 void str_timestamp(uint32_t ts, char *buffer, size_t size);
 void print_inode(const struct inode *in, uint32_t inode_nbr, const char *filename);
 int name_is_valid(const char *name);
-int dir_lookup(const char *image_path, const char *filename);
-int add_dir_entry(const char *image_path, const char *filename, uint32_t inode_number);
-int remove_dir_entry(const char *image_path, const char *filename);
+int path_is_valid(const char *path);
+int dir_resolve(const char *image_path, const char *path, uint32_t *parent, char *name);
+int dir_lookup_in(const char *image_path, uint32_t dir_inode, const char *name, uint16_t *mode);
+int dir_lookup(const char *image_path, const char *path);
+int add_dir_entry(const char *image_path, const char *path, uint32_t inode_number);
+int remove_dir_entry(const char *image_path, const char *path);
+
+// dir-hash.c
+uint32_t dir_name_hash(const char *name);
+int dir_header_read(const char *image_path, uint32_t dir_inode, struct inode *dir, struct dir_header *hdr);
+int dir_header_write(const char *image_path, struct inode *dir, const struct dir_header *hdr);
+int dir_hash_find(const char *image_path, struct inode *dir, const struct dir_header *hdr, const char *name,
+                  uint32_t *loc);
+int dir_hash_insert(const char *image_path, struct inode *dir, struct dir_header *hdr, const char *name,
+                    uint32_t loc);
+int dir_hash_remove(const char *image_path, struct dir_header *hdr, const char *name, uint32_t loc);
+int dir_hash_build(const char *image_path, struct inode *dir, struct dir_header *hdr);
+void dir_hash_drop(const char *image_path, struct dir_header *hdr);
+
+// dir-tree.c
+int dir_tree_insert(const char *image_path, struct inode *dir, struct dir_header *hdr, const char *name,
+                    uint32_t inode_number);
+int dir_tree_remove(const char *image_path, struct dir_header *hdr, const char *name);
+int dir_tree_build(const char *image_path, struct inode *dir, struct dir_header *hdr);
+void dir_tree_drop(const char *image_path, struct dir_header *hdr);
+int dir_tree_iter_init(struct dir_tree_iter *it, const char *image_path, const struct dir_header *hdr,
+                       const char *start);
+int dir_tree_iter_next(struct dir_tree_iter *it, struct dir_entry *entry);
+
+// dir-bloom.c
+int dir_bloom_test(const char *image_path, const struct dir_header *hdr, const char *name);
+int dir_bloom_add(const char *image_path, struct inode *dir, struct dir_header *hdr, const char *name);
+int dir_bloom_remove(const char *image_path, struct inode *dir, struct dir_header *hdr);
+int dir_bloom_build(const char *image_path, struct inode *dir, struct dir_header *hdr);
+void dir_bloom_drop(const char *image_path, struct dir_header *hdr);
 
 #endif // VFS_H
@@ -0,0 +1,95 @@
+// bench-bitmap.c
+// Compara la busqueda del primer bit libre byte a byte (la version anterior de
+// bitmap_set_first_free) con bitmap_find_first_zero, sobre bloques de bitmap
+// llenos, fragmentados y vacios.
+// Uso: ./bench-bitmap [iteraciones]
+
+#define _POSIX_C_SOURCE 200809L // clock_gettime
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "vfs.h"
+
+static int old_find_first_zero(const uint8_t *bitmap, uint32_t nbytes) {
+    // Busqueda original: primer byte distinto de 0xFF y despues bit por bit
+    int byte_index = -1;
+    for (uint32_t i = 0; i < nbytes; i++) {
+        if (bitmap[i] != 0xFF) {
+            byte_index = i;
+            break;
+        }
+    }
+
+    if (byte_index == -1)
+        return -1;
+
+    for (int b = 0; b < 8; b++) {
+        uint8_t mask = 1 << (7 - b);
+        if (!(bitmap[byte_index] & mask))
+            return byte_index * 8 + b;
+    }
+    return -1;
+}
+
+static double now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static void run_case(const char *name, const uint8_t *bitmap, long iterations) {
+    // Mide ambas busquedas sobre el mismo bitmap y verifica que coincidan
+    volatile int sink = 0;
+    int expected = old_find_first_zero(bitmap, BLOCK_SIZE);
+    int found = bitmap_find_first_zero(bitmap, BLOCK_SIZE);
+    if (expected != found) {
+        fprintf(stderr, "Error: %s: la busqueda anterior da %d y la nueva %d\n", name, expected, found);
+        exit(1);
+    }
+
+    double start = now_ns();
+    for (long i = 0; i < iterations; i++)
+        sink += old_find_first_zero(bitmap, BLOCK_SIZE);
+    double old_ns = (now_ns() - start) / iterations;
+
+    start = now_ns();
+    for (long i = 0; i < iterations; i++)
+        sink += bitmap_find_first_zero(bitmap, BLOCK_SIZE);
+    double new_ns = (now_ns() - start) / iterations;
+
+    (void)sink;
+    printf("%-12s bit %5d  anterior %8.1f ns  nueva %8.1f ns  (x%.1f)\n", name, found, old_ns, new_ns,
+           new_ns > 0 ? old_ns / new_ns : 0);
+}
+
+int main(int argc, char *argv[]) {
+    long iterations = argc > 1 ? atol(argv[1]) : 200000;
+    if (iterations <= 0) {
+        fprintf(stderr, "Uso: %s [iteraciones]\n", argv[0]);
+        return 1;
+    }
+
+    static uint8_t bitmap[BLOCK_SIZE];
+
+    // Lleno: solo queda libre el ultimo bit del bloque
+    memset(bitmap, 0xFF, BLOCK_SIZE);
+    bitmap[BLOCK_SIZE - 1] = 0xFE;
+    run_case("lleno", bitmap, iterations);
+
+    // Fragmentado: la primera mitad ocupada y el resto con bits libres sueltos
+    srand(1);
+    memset(bitmap, 0xFF, BLOCK_SIZE / 2);
+    for (uint32_t i = BLOCK_SIZE / 2; i < BLOCK_SIZE; i++)
+        bitmap[i] = (rand() % 8 == 0) ? (uint8_t)~(1 << (rand() % 8)) : 0xFF;
+    run_case("fragmentado", bitmap, iterations);
+
+    // Vacio: el primer bit ya esta libre
+    memset(bitmap, 0, BLOCK_SIZE);
+    run_case("vacio", bitmap, iterations);
+
+    return 0;
+}
@@ -3,9 +3,157 @@
 #include "vfs.h"
 #include <stdint.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 
-int bitmap_free_block(const char *image_path, uint32_t block_nbr) {
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define BITMAP_HAVE_X86 1
+#else
+#define BITMAP_HAVE_X86 0
+#endif
+
+/*
+    Busqueda del primer bit en cero del bitmap
+
+    Los bits se numeran de izquierda a derecha dentro de cada byte (el bit 0 es el mas
+    significativo del byte 0). Leyendo 8 bytes como un entero big-endian, ese orden coincide
+    con el de los bits del entero, asi que el primer cero de la palabra es __builtin_clzll(~w).
+
+    En x86 antes se saltean los tramos completamente ocupados comparando 32 bytes por
+    instruccion (AVX2) o 16 (SSE2). Cual se usa se decide la primera vez, segun el procesador.
+*/
+
+#if BITMAP_HAVE_X86
+__attribute__((target("avx2"))) static uint32_t skip_full_avx2(const uint8_t *bitmap, uint32_t nbytes) {
+    // Retorna el offset del primer tramo de 32 bytes que no esta todo en 0xFF
+    const __m256i ones = _mm256_set1_epi8((char)0xFF);
+    uint32_t i = 0;
+    for (; i + 32 <= nbytes; i += 32) {
+        __m256i v = _mm256_loadu_si256((const __m256i *)(bitmap + i));
+        if ((uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, ones)) != 0xFFFFFFFFu)
+            break;
+    }
+    return i;
+}
+
+__attribute__((target("sse2"))) static uint32_t skip_full_sse2(const uint8_t *bitmap, uint32_t nbytes) {
+    // Retorna el offset del primer tramo de 16 bytes que no esta todo en 0xFF
+    const __m128i ones = _mm_set1_epi8((char)0xFF);
+    uint32_t i = 0;
+    for (; i + 16 <= nbytes; i += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i *)(bitmap + i));
+        if (_mm_movemask_epi8(_mm_cmpeq_epi8(v, ones)) != 0xFFFF)
+            break;
+    }
+    return i;
+}
+#endif
+
+static uint32_t skip_full_none(const uint8_t *bitmap, uint32_t nbytes) {
+    (void)bitmap;
+    (void)nbytes;
+    return 0;
+}
+
+static uint32_t (*skip_full)(const uint8_t *, uint32_t) = NULL;
+
+static void select_skip_full(void) {
+    skip_full = skip_full_none;
+#if BITMAP_HAVE_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+        skip_full = skip_full_avx2;
+    else if (__builtin_cpu_supports("sse2"))
+        skip_full = skip_full_sse2;
+#endif
+}
+
+static uint64_t load_be64(const uint8_t *p) {
+    // Lee 8 bytes como entero big-endian (el primer byte queda en los bits mas altos)
+    uint64_t w;
+    memcpy(&w, p, sizeof(w));
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    w = __builtin_bswap64(w);
+#endif
+    return w;
+}
+
+int bitmap_find_first_zero(const uint8_t *bitmap, uint32_t nbytes) {
+    // Retorna el índice del primer bit en cero de los nbytes de bitmap,
+    // o -1 si están todos en uno
+    // Caso comun en un bitmap poco usado: hay un cero en la primera palabra
+    if (nbytes >= 8) {
+        uint64_t first = load_be64(bitmap);
+        if (first != UINT64_MAX)
+            return __builtin_clzll(~first);
+    }
+
+    if (skip_full == NULL)
+        select_skip_full();
+
+    uint32_t i = skip_full(bitmap, nbytes);
+
+    for (; i + 8 <= nbytes; i += 8) {
+        uint64_t w = load_be64(bitmap + i);
+        if (w != UINT64_MAX)
+            return i * 8 + __builtin_clzll(~w);
+    }
+
+    for (; i < nbytes; i++) {
+        if (bitmap[i] != 0xFF) {
+            // El byte queda en los 8 bits altos de un entero de 32 bits
+            uint32_t inverted = (uint32_t)(uint8_t)~bitmap[i] << 24;
+            return i * 8 + __builtin_clz(inverted);
+        }
+    }
+
+    return -1;
+}
+
+static int bitmap_bit(const uint8_t *bitmap, uint32_t bit) {
+    return (bitmap[bit / 8] >> (7 - bit % 8)) & 1;
+}
+
+static uint32_t scan_from(const uint8_t *bitmap, uint32_t nbits, uint32_t from, int value) {
+    // Retorna la posicion del primer bit igual a value desde from, o nbits si no hay
+    while (from < nbits && from % 64 != 0) {
+        if (bitmap_bit(bitmap, from) == value)
+            return from;
+        from++;
+    }
+
+    for (; from + 64 <= nbits; from += 64) {
+        uint64_t w = load_be64(bitmap + from / 8);
+        if (!value)
+            w = ~w;
+        if (w != 0)
+            return from + __builtin_clzll(w);
+    }
+
+    for (; from < nbits; from++) {
+        if (bitmap_bit(bitmap, from) == value)
+            return from;
+    }
+    return nbits;
+}
+
+static void set_bit_range(uint8_t *bitmap, uint32_t start, uint32_t len) {
+    // Pone en uno los bits [start, start + len), de a bytes completos donde se puede
+    uint32_t bit = start, end = start + len;
+    while (bit < end && bit % 8 != 0) {
+        bitmap[bit / 8] |= 1 << (7 - bit % 8);
+        bit++;
+    }
+    if (end - bit >= 8) {
+        memset(bitmap + bit / 8, 0xFF, (end - bit) / 8);
+        bit += (end - bit) / 8 * 8;
+    }
+    for (; bit < end; bit++)
+        bitmap[bit / 8] |= 1 << (7 - bit % 8);
+}
+
+static int clear_block_bit(const char *image_path, uint32_t block_nbr) {
     /*
         Escribe un cero en la posicion block_nbr del bitmap
         Pasos:
@@ -15,6 +163,7 @@ int bitmap_free_block(const char *image_path, uint32_t block_nbr) {
             Desmarca el bit correspondiente (lo pone en 0).
             Actualiza bitmap_zeroes[] y free_blocks en el superbloque.
             Escribe el bitmap y el superbloque actualizados.
+        Retorna 0 si lo liberó, 1 si ya estaba libre, -1 en caso de error
     */
     struct superblock sb_struct, *sb = &sb_struct;
 
@@ -50,7 +199,7 @@ int bitmap_free_block(const char *image_path, uint32_t block_nbr) {
     // Verificar que el bit estaba en 1
     if (!(bitmap_buffer[byte_index] & bit_mask)) {
         DEBUG_PRINT("Advertencia: el bloque %u ya estaba libre\n", block_nbr);
-        return 0;
+        return 1;
     }
 
     // Marcar el bit como libre
@@ -62,6 +211,25 @@ int bitmap_free_block(const char *image_path, uint32_t block_nbr) {
         return -1;
     }
 
+    // Actualizar metadata del superbloque
+    sb->bitmap_zeroes[bitmap_block_offset]++;
+    sb->free_blocks++;
+
+    if (write_superblock(image_path, sb) != 0) {
+        fprintf(stderr, "Error al escribir superbloque\n");
+        return -1;
+    }
+
+    return 0;
+}
+
+int bitmap_free_block(const char *image_path, uint32_t block_nbr) {
+    // Marca como libre el bloque block_nbr en el bitmap y escribe ceros en él
+    // Retorna 0 o -1 en caso de error
+    int result = clear_block_bit(image_path, block_nbr);
+    if (result != 0)
+        return result < 0 ? -1 : 0;
+
     // Escribir ceros en el bloque de datos liberado
     DEBUG_PRINT("Escribiendo ceros en bloque %u que quedo libre\n", block_nbr);
     uint8_t zero_buf[BLOCK_SIZE] = {0};
@@ -70,16 +238,120 @@ int bitmap_free_block(const char *image_path, uint32_t block_nbr) {
         return -1;
     }
 
-    // Actualizar metadata del superbloque
-    sb->bitmap_zeroes[bitmap_block_offset]++;
-    sb->free_blocks++;
+    return 0;
+}
 
+static int compare_block_numbers(const void *a, const void *b) {
+    uint32_t x = *(const uint32_t *)a, y = *(const uint32_t *)b;
+    return (x > y) - (x < y);
+}
+
+int bitmap_free_blocks(const char *image_path, const uint32_t *blocks, uint32_t count, int zero_fill) {
+    // Marca como libres los count bloques de blocks. Si zero_fill, antes escribe ceros en
+    // todos con una sola escritura vectorizada.
+    // Invariante: todo bloque libre esta en cero (mkfs los crea asi y inode_write_data no
+    // lee ni escribe las partes nuevas o huecos de un archivo). zero_fill = 0 solo vale
+    // para bloques que no se escribieron desde que se reservaron.
+    // Cada bloque de bitmap afectado se lee y escribe una sola vez, y el superbloque
+    // se actualiza una vez al final. Los números inválidos se informan y se saltean;
+    // los que ya estaban libres se ignoran.
+    // Retorna 0 o -1 en caso de error
+    if (count == 0)
+        return 0;
+
+    struct superblock sb_struct, *sb = &sb_struct;
+
+    if (read_superblock(image_path, sb) != 0) {
+        fprintf(stderr, "Error al leer superblock\n");
+        return -1;
+    }
+
+    uint32_t *sorted = malloc(count * sizeof(uint32_t));
+    if (sorted == NULL) {
+        fprintf(stderr, "Error: sin memoria para liberar %u bloques\n", count);
+        return -1;
+    }
+
+    uint32_t valid = 0;
+    for (uint32_t k = 0; k < count; k++) {
+        if (blocks[k] <= sb->data_start || blocks[k] >= sb->total_blocks) { // no liberar el directorio raiz
+            fprintf(stderr, "Error: número de bloque inválido (%u)\n", blocks[k]);
+            continue;
+        }
+        sorted[valid++] = blocks[k];
+    }
+    qsort(sorted, valid, sizeof(uint32_t), compare_block_numbers);
+
+    int result = 0;
+
+    if (zero_fill && valid > 0) {
+        static const uint8_t zero_buf[BLOCK_SIZE] = {0};
+        const void **zero_bufs = malloc(valid * sizeof(void *));
+        if (zero_bufs == NULL) {
+            fprintf(stderr, "Error: sin memoria para liberar %u bloques\n", valid);
+            free(sorted);
+            return -1;
+        }
+        for (uint32_t k = 0; k < valid; k++)
+            zero_bufs[k] = zero_buf;
+
+        DEBUG_PRINT("Escribiendo ceros en %u bloques que quedan libres\n", valid);
+        result = write_blocks(image_path, sorted, zero_bufs, valid);
+        free(zero_bufs);
+        if (result != 0) {
+            fprintf(stderr, "Error al limpiar los bloques liberados.\n");
+            free(sorted);
+            return -1;
+        }
+    }
+
+    // Recorrer los bloques agrupados por bloque de bitmap (quedaron ordenados)
+    uint8_t bitmap_buffer[BLOCK_SIZE];
+    uint32_t k = 0;
+    while (k < valid) {
+        uint32_t bitmap_block_offset = sorted[k] / BITS_PER_BLOCK;
+        int bitmap_block_num = sb->bitmap_start + bitmap_block_offset;
+
+        if (read_block(image_path, bitmap_block_num, bitmap_buffer) != 0) {
+            fprintf(stderr, "Error al leer bloque de bitmap %d\n", bitmap_block_num);
+            result = -1;
+            break;
+        }
+
+        uint32_t freed = 0;
+        for (; k < valid && sorted[k] / BITS_PER_BLOCK == bitmap_block_offset; k++) {
+            uint32_t bit = sorted[k] % BITS_PER_BLOCK;
+            uint8_t bit_mask = 1 << (7 - bit % 8);
+            if (!(bitmap_buffer[bit / 8] & bit_mask)) {
+                DEBUG_PRINT("Advertencia: el bloque %u ya estaba libre\n", sorted[k]);
+                continue;
+            }
+            bitmap_buffer[bit / 8] &= ~bit_mask;
+            freed++;
+        }
+
+        if (freed == 0)
+            continue;
+
+        if (write_block(image_path, bitmap_block_num, bitmap_buffer) != 0) {
+            fprintf(stderr, "Error al escribir bloque de bitmap %d\n", bitmap_block_num);
+            result = -1;
+            break;
+        }
+
+        sb->bitmap_zeroes[bitmap_block_offset] += freed;
+        sb->free_blocks += freed;
+    }
+
+    free(sorted);
+
+    // Aun si hubo error, se registran los bloques que ya quedaron libres en el bitmap
     if (write_superblock(image_path, sb) != 0) {
         fprintf(stderr, "Error al escribir superbloque\n");
         return -1;
     }
 
-    return 0;
+    return result;
 }
 
 int bitmap_set_first_free(const char *image_path) {
@@ -123,46 +395,24 @@ int bitmap_set_first_free(const char *image_path) {
         return -1;
     }
 
-    // Paso 4: encontrar primer byte con algún bit libre
-    int byte_index = -1;
-    for (int i = 0; i < BLOCK_SIZE; i++) {
-        if (bitmap_buffer[i] != 0xFF) {
-            byte_index = i;
-            break;
-        }
-    }
-
-    if (byte_index == -1) {
+    // Paso 4: encontrar el primer bit libre del bloque y marcarlo como ocupado
+    int bit_in_block = bitmap_find_first_zero(bitmap_buffer, BLOCK_SIZE);
+    if (bit_in_block == -1) {
         fprintf(stderr, "Error: inconsistencia: bitmap parece lleno pero metadata indica espacio\n");
         return -1;
     }
 
-    // Paso 5: encontrar primer bit libre en ese byte (de izquierda a derecha)
-    int bit_index = -1;
-    for (int b = 0; b < 8; b++) {
-        uint8_t mask = 1 << (7 - b); // bit shift a la izquierda
-        if (!(bitmap_buffer[byte_index] & mask)) {
-            // Marcar el bit como ocupado
-            bitmap_buffer[byte_index] |= mask;
-            bit_index = b;
-            break;
-        }
-    }
-
-    if (bit_index == -1) {
-        fprintf(stderr, "Error: inconsistencia en el byte del bitmap\n");
-        return -1;
-    }
+    bitmap_buffer[bit_in_block / 8] |= 1 << (7 - bit_in_block % 8);
 
-    // Paso 6: calcular número de bloque, usando
-    uint32_t block_number = bitmap_block_offset * BLOCK_SIZE * 8 + byte_index * 8 + bit_index;
+    // Paso 5: calcular número de bloque
+    uint32_t block_number = bitmap_block_offset * BITS_PER_BLOCK + bit_in_block;
 
     if (block_number >= sb->total_blocks) {
         fprintf(stderr, "Error: número de bloque fuera de rango\n");
         return -1;
     }
 
-    // Paso 7: escribir bloque de bitmap y actualizar superbloque
+    // Paso 6: escribir bloque de bitmap y actualizar superbloque
     if (write_block(image_path, bitmap_block_num, bitmap_buffer) != 0) {
         fprintf(stderr, "Error: no se pudo escribir el bloque de bitmap\n");
         return -1;
@@ -179,6 +429,120 @@ int bitmap_set_first_free(const char *image_path) {
     return block_number;
 }
 
+int bitmap_alloc_run(const char *image_path, uint32_t max_len, struct block_run *run) {
+    // Reserva hasta max_len bloques libres contiguos y los retorna en run.
+    // Usa el primer tramo libre de al menos max_len bloques; si no hay ninguno
+    // (espacio fragmentado), reserva el tramo libre mas largo, que queda mas corto.
+    // El bloque de bitmap y el superbloque se escriben una sola vez.
+    // Retorna 0, o -1 en caso de error o si no hay bloques libres.
+    struct superblock sb_struct, *sb = &sb_struct;
+
+    if (max_len == 0) {
+        fprintf(stderr, "Error: se pidió reservar un tramo vacío\n");
+        return -1;
+    }
+
+    if (read_superblock(image_path, sb) != 0) {
+        fprintf(stderr, "Error al leer superblock\n");
+        return -1;
+    }
+
+    if (sb->free_blocks == 0) {
+        fprintf(stderr, "Error: no hay bloques libres\n");
+        return -1;
+    }
+
+    uint8_t bitmap_buffer[BLOCK_SIZE];
+    uint32_t best_offset = 0, best_start = 0, best_len = 0;
+
+    for (uint32_t i = 0; i < sb->bitmap_blocks && best_len < max_len; i++) {
+        if (sb->bitmap_zeroes[i] == 0)
+            continue;
+
+        if (read_block(image_path, sb->bitmap_start + i, bitmap_buffer) != 0) {
+            fprintf(stderr, "Error: no se pudo leer el bloque de bitmap\n");
+            return -1;
+        }
+
+        // El ultimo bloque de bitmap puede tener bits de mas, fuera de la imagen
+        uint32_t nbits = BITS_PER_BLOCK;
+        if ((i + 1) * BITS_PER_BLOCK > sb->total_blocks)
+            nbits = sb->total_blocks - i * BITS_PER_BLOCK;
+
+        // Recorrer los tramos de ceros del bloque
+        uint32_t pos = 0;
+        while (pos < nbits) {
+            uint32_t zero = scan_from(bitmap_buffer, nbits, pos, 0);
+            if (zero >= nbits)
+                break;
+            uint32_t one = scan_from(bitmap_buffer, nbits, zero, 1);
+
+            if (one - zero > best_len) {
+                best_offset = i;
+                best_start = zero;
+                best_len = one - zero;
+                if (best_len >= max_len)
+                    break;
+            }
+            pos = one;
+        }
+    }
+
+    if (best_len == 0) {
+        fprintf(stderr, "Error: inconsistencia: bitmap_zeroes no refleja bloques libres\n");
+        return -1;
+    }
+    if (best_len > max_len)
+        best_len = max_len;
+
+    // Marcar el tramo como ocupado (el buffer puede ser de otro bloque de bitmap)
+    int bitmap_block_num = sb->bitmap_start + best_offset;
+    if (read_block(image_path, bitmap_block_num, bitmap_buffer) != 0) {
+        fprintf(stderr, "Error: no se pudo leer el bloque de bitmap\n");
+        return -1;
+    }
+
+    set_bit_range(bitmap_buffer, best_start, best_len);
+
+    if (write_block(image_path, bitmap_block_num, bitmap_buffer) != 0) {
+        fprintf(stderr, "Error: no se pudo escribir el bloque de bitmap\n");
+        return -1;
+    }
+
+    sb->bitmap_zeroes[best_offset] -= best_len;
+    sb->free_blocks -= best_len;
+
+    if (write_superblock(image_path, sb) != 0) {
+        fprintf(stderr, "Error: no se pudo escribir el superbloque\n");
+        return -1;
+    }
+
+    run->start = best_offset * BITS_PER_BLOCK + best_start;
+    run->len = best_len;
+    DEBUG_PRINT("Tramo reservado: %u bloques desde el %u\n", run->len, run->start);
+    return 0;
+}
+
+int bitmap_alloc_blocks(const char *image_path, uint32_t count, uint32_t *blocks) {
+    // Reserva count bloques, en la menor cantidad de tramos contiguos posible,
+    // y deja sus números en blocks en orden.
+    // Retorna 0, o -1 en caso de error (los tramos ya reservados se vuelven a liberar)
+    uint32_t done = 0;
+    while (done < count) {
+        struct block_run run;
+        if (bitmap_alloc_run(image_path, count - done, &run) != 0) {
+            // Los bloques reservados no se llegaron a escribir: siguen en cero
+            if (done > 0 && bitmap_free_blocks(image_path, blocks, done, 0) != 0)
+                fprintf(stderr, "Error al liberar %u bloques ya reservados\n", done);
+            return -1;
+        }
+
+        for (uint32_t k = 0; k < run.len; k++)
+            blocks[done++] = run.start + k;
+    }
+    return 0;
+}
+
 void print_bitmap_block(uint8_t *buffer, uint32_t size) {
     // Escribe el bitmap en lineas de ROW_WIDTH de ancho
     // Usa # para marcar bloque ocupado y . para libre
@@ -0,0 +1,364 @@
+// block-cache.c
+
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "vfs.h"
+
+/*
+    Cache de bloques con politica LRU y escritura diferida (write-back)
+
+    Se ubica debajo de read_block/write_block: las lecturas repetidas del mismo bloque
+    (superbloque, bitmap, tabla de nodos-I, directorio) se sirven desde memoria y las
+    escrituras solo marcan el bloque como sucio. Un bloque sucio llega a la imagen
+    cuando se lo desaloja o cuando se confirma con vfs_sync/vfs_close.
+
+    Las entradas se encadenan por indices en una lista doblemente enlazada (la cabeza
+    es la usada mas recientemente) y en una tabla hash por numero de bloque.
+*/
+
+#define NO_ENTRY (-1)
+
+struct cache_entry {
+    int block;     // Numero de bloque guardado, NO_ENTRY si la entrada esta libre
+    int dirty;     // 1 si hay que escribirlo en la imagen antes de descartarlo
+    int prev;      // Entrada usada mas recientemente que esta
+    int next;      // Entrada usada menos recientemente que esta
+    int hash_next; // Siguiente entrada en el mismo bucket de la tabla hash
+    uint8_t data[BLOCK_SIZE];
+};
+
+struct block_cache {
+    uint32_t capacity;  // Cantidad maxima de bloques en memoria
+    uint32_t used;      // Cantidad de entradas ocupadas
+    int lru_head;       // Usada mas recientemente
+    int lru_tail;       // Usada menos recientemente, primera candidata a desalojar
+    uint32_t nbuckets;  // Potencia de 2
+    int *buckets;
+    struct cache_entry *entries;
+    struct vfs_cache_stats stats;
+};
+
+static uint32_t default_capacity = VFS_CACHE_DEFAULT_BLOCKS;
+
+void vfs_cache_set_capacity(uint32_t blocks) {
+    // Cantidad de bloques del cache de las imagenes que se abran de aqui en adelante
+    // Con 0 no se usa cache
+    default_capacity = blocks;
+}
+
+struct block_cache *cache_create(void) {
+    // Retorna un cache vacio con la capacidad configurada, o NULL si no se usa cache
+    if (default_capacity == 0)
+        return NULL;
+
+    struct block_cache *cache = calloc(1, sizeof(struct block_cache));
+    if (cache == NULL)
+        return NULL;
+
+    cache->capacity = default_capacity;
+    cache->nbuckets = 1;
+    while (cache->nbuckets < cache->capacity)
+        cache->nbuckets <<= 1;
+
+    cache->buckets = malloc(cache->nbuckets * sizeof(int));
+    cache->entries = malloc(cache->capacity * sizeof(struct cache_entry));
+    if (cache->buckets == NULL || cache->entries == NULL) {
+        free(cache->buckets);
+        free(cache->entries);
+        free(cache);
+        return NULL;
+    }
+
+    for (uint32_t i = 0; i < cache->nbuckets; i++)
+        cache->buckets[i] = NO_ENTRY;
+    cache->lru_head = cache->lru_tail = NO_ENTRY;
+
+    return cache;
+}
+
+void cache_destroy(struct block_cache *cache) {
+    // Libera el cache sin escribir nada; antes hay que invocar cache_flush
+    if (cache == NULL)
+        return;
+
+    DEBUG_PRINT("Cache: %llu aciertos, %llu fallos, %llu desalojos, %llu escrituras diferidas\n",
+                (unsigned long long)cache->stats.hits, (unsigned long long)cache->stats.misses,
+                (unsigned long long)cache->stats.evictions, (unsigned long long)cache->stats.writebacks);
+    free(cache->buckets);
+    free(cache->entries);
+    free(cache);
+}
+
+void cache_get_stats(const struct block_cache *cache, struct vfs_cache_stats *stats) {
+    if (cache == NULL) {
+        memset(stats, 0, sizeof(struct vfs_cache_stats));
+        return;
+    }
+    *stats = cache->stats;
+}
+
+static uint32_t bucket_of(const struct block_cache *cache, int block_number) {
+    return (uint32_t)block_number & (cache->nbuckets - 1);
+}
+
+static int cache_find(const struct block_cache *cache, int block_number) {
+    // Retorna el indice de la entrada que guarda block_number, o NO_ENTRY
+    int e = cache->buckets[bucket_of(cache, block_number)];
+    while (e != NO_ENTRY && cache->entries[e].block != block_number)
+        e = cache->entries[e].hash_next;
+    return e;
+}
+
+static void lru_unlink(struct block_cache *cache, int e) {
+    struct cache_entry *entry = &cache->entries[e];
+
+    if (entry->prev != NO_ENTRY)
+        cache->entries[entry->prev].next = entry->next;
+    else
+        cache->lru_head = entry->next;
+
+    if (entry->next != NO_ENTRY)
+        cache->entries[entry->next].prev = entry->prev;
+    else
+        cache->lru_tail = entry->prev;
+}
+
+static void lru_push_head(struct block_cache *cache, int e) {
+    struct cache_entry *entry = &cache->entries[e];
+
+    entry->prev = NO_ENTRY;
+    entry->next = cache->lru_head;
+    if (cache->lru_head != NO_ENTRY)
+        cache->entries[cache->lru_head].prev = e;
+    cache->lru_head = e;
+    if (cache->lru_tail == NO_ENTRY)
+        cache->lru_tail = e;
+}
+
+static void hash_remove(struct block_cache *cache, int e) {
+    int *link = &cache->buckets[bucket_of(cache, cache->entries[e].block)];
+    while (*link != e)
+        link = &cache->entries[*link].hash_next;
+    *link = cache->entries[e].hash_next;
+}
+
+static int cache_slot(struct vfs_dev *dev, int block_number) {
+    // Obtiene una entrada para block_number, desalojando la menos usada si el cache esta lleno
+    // La entrada queda en la tabla hash y al frente de la lista LRU, con datos sin definir
+    // Retorna el indice de la entrada, o NO_ENTRY si no se pudo escribir el bloque desalojado
+    struct block_cache *cache = dev->cache;
+    int e;
+
+    if (cache->used < cache->capacity) {
+        e = cache->used++;
+    }
+    else {
+        e = cache->lru_tail;
+        struct cache_entry *victim = &cache->entries[e];
+
+        if (victim->dirty) {
+            if (dev_pwrite_block(dev, victim->block, victim->data) != 0)
+                return NO_ENTRY;
+            cache->stats.writebacks++;
+        }
+
+        lru_unlink(cache, e);
+        if (victim->block != NO_ENTRY) {
+            DEBUG_PRINT("Cache: desalojando bloque %d\n", victim->block);
+            hash_remove(cache, e);
+            cache->stats.evictions++;
+        }
+    }
+
+    struct cache_entry *entry = &cache->entries[e];
+    entry->block = block_number;
+    entry->dirty = 0;
+    uint32_t b = bucket_of(cache, block_number);
+    entry->hash_next = cache->buckets[b];
+    cache->buckets[b] = e;
+    lru_push_head(cache, e);
+
+    return e;
+}
+
+static void cache_drop(struct block_cache *cache, int e) {
+    // Devuelve una entrada recien obtenida con cache_slot, cuya lectura fallo
+    // Queda al final de la lista LRU, fuera de la tabla hash, para reusarse primero
+    hash_remove(cache, e);
+    lru_unlink(cache, e);
+    cache->entries[e].block = NO_ENTRY;
+
+    struct cache_entry *entry = &cache->entries[e];
+    entry->next = NO_ENTRY;
+    entry->prev = cache->lru_tail;
+    if (cache->lru_tail != NO_ENTRY)
+        cache->entries[cache->lru_tail].next = e;
+    cache->lru_tail = e;
+    if (cache->lru_head == NO_ENTRY)
+        cache->lru_head = e;
+}
+
+int cache_read(struct vfs_dev *dev, int block_number, void *buffer) {
+    // Lee un bloque a traves del cache. Retorna 0 o -1
+    struct block_cache *cache = dev->cache;
+
+    int e = cache_find(cache, block_number);
+    if (e != NO_ENTRY) {
+        cache->stats.hits++;
+        lru_unlink(cache, e);
+        lru_push_head(cache, e);
+        memcpy(buffer, cache->entries[e].data, BLOCK_SIZE);
+        return 0;
+    }
+
+    cache->stats.misses++;
+    e = cache_slot(dev, block_number);
+    if (e == NO_ENTRY)
+        return -1;
+
+    if (dev_pread_block(dev, block_number, cache->entries[e].data) != 0) {
+        int saved_errno = errno;
+        cache_drop(cache, e);
+        errno = saved_errno;
+        return -1;
+    }
+
+    memcpy(buffer, cache->entries[e].data, BLOCK_SIZE);
+    return 0;
+}
+
+int cache_contains(struct vfs_dev *dev, int block_number) {
+    // Retorna 1 si block_number esta en el cache, sin alterar el orden LRU
+    return cache_find(dev->cache, block_number) != NO_ENTRY;
+}
+
+int cache_lookup(struct vfs_dev *dev, int block_number, void *buffer) {
+    // Si block_number esta en el cache lo copia en buffer y retorna 1
+    // Si no esta retorna 0, sin leerlo ni agregarlo (lo usan las lecturas de datos en bloque)
+    struct block_cache *cache = dev->cache;
+
+    int e = cache_find(cache, block_number);
+    if (e == NO_ENTRY)
+        return 0;
+
+    cache->stats.hits++;
+    lru_unlink(cache, e);
+    lru_push_head(cache, e);
+    memcpy(buffer, cache->entries[e].data, BLOCK_SIZE);
+    return 1;
+}
+
+int cache_update(struct vfs_dev *dev, int block_number, const void *buffer) {
+    // Si block_number esta en el cache reemplaza su contenido (queda sucio) y retorna 1
+    // Si no esta retorna 0 y el invocador debe escribirlo directamente en la imagen
+    struct block_cache *cache = dev->cache;
+
+    int e = cache_find(cache, block_number);
+    if (e == NO_ENTRY)
+        return 0;
+
+    cache->stats.hits++;
+    lru_unlink(cache, e);
+    lru_push_head(cache, e);
+    memcpy(cache->entries[e].data, buffer, BLOCK_SIZE);
+    cache->entries[e].dirty = 1;
+    return 1;
+}
+
+int cache_write(struct vfs_dev *dev, int block_number, const void *buffer) {
+    // Escribe un bloque en el cache, que queda sucio hasta el proximo cache_flush
+    // Como se reemplaza el bloque completo, un fallo no necesita leerlo de la imagen
+    // Retorna 0 o -1
+    struct block_cache *cache = dev->cache;
+
+    int e = cache_find(cache, block_number);
+    if (e != NO_ENTRY) {
+        cache->stats.hits++;
+        lru_unlink(cache, e);
+        lru_push_head(cache, e);
+    }
+    else {
+        cache->stats.misses++;
+        e = cache_slot(dev, block_number);
+        if (e == NO_ENTRY)
+            return -1;
+    }
+
+    memcpy(cache->entries[e].data, buffer, BLOCK_SIZE);
+    cache->entries[e].dirty = 1;
+    return 0;
+}
+
+static const struct cache_entry *sort_base; // entradas a las que apuntan los indices que ordena compare_dirty
+
+static int compare_dirty(const void *a, const void *b) {
+    // Ordena indices de entradas por numero de bloque, para escribir en orden en la imagen
+    int ba = sort_base[*(const int *)a].block;
+    int bb = sort_base[*(const int *)b].block;
+    return (ba > bb) - (ba < bb);
+}
+
+int cache_flush(struct vfs_dev *dev) {
+    // Escribe en la imagen todos los bloques sucios, en orden de numero de bloque,
+    // agrupando los consecutivos en una sola llamada pwritev
+    // Retorna 0 o -1 (los bloques que no se pudieron escribir quedan sucios)
+    struct block_cache *cache = dev->cache;
+    if (cache == NULL)
+        return 0;
+
+    uint32_t count = 0;
+    for (uint32_t e = 0; e < cache->used; e++) {
+        if (cache->entries[e].block != NO_ENTRY && cache->entries[e].dirty)
+            count++;
+    }
+    if (count == 0)
+        return 0;
+
+    int *dirty = malloc(count * sizeof(int));
+    const void **buffers = malloc(count * sizeof(void *));
+    if (dirty == NULL || buffers == NULL) {
+        free(dirty);
+        free(buffers);
+        return -1;
+    }
+
+    count = 0;
+    for (uint32_t e = 0; e < cache->used; e++) {
+        if (cache->entries[e].block != NO_ENTRY && cache->entries[e].dirty)
+            dirty[count++] = e;
+    }
+
+    sort_base = cache->entries;
+    qsort(dirty, count, sizeof(int), compare_dirty);
+
+    int result = 0;
+    uint32_t i = 0;
+    while (i < count) {
+        // Tramo de bloques sucios consecutivos en la imagen
+        uint32_t n = 1;
+        while (i + n < count && cache->entries[dirty[i + n]].block == cache->entries[dirty[i + n - 1]].block + 1)
+            n++;
+
+        for (uint32_t j = 0; j < n; j++)
+            buffers[j] = cache->entries[dirty[i + j]].data;
+
+        if (dev_pwritev_run(dev, cache->entries[dirty[i]].block, buffers, n) != 0) {
+            result = -1;
+        }
+        else {
+            for (uint32_t j = 0; j < n; j++)
+                cache->entries[dirty[i + j]].dirty = 0;
+            cache->stats.writebacks += n;
+        }
+        i += n;
+    }
+
+    DEBUG_PRINT("Cache: %u bloques sucios escritos\n", count);
+    free(dirty);
+    free(buffers);
+    return result;
+}
@@ -0,0 +1,429 @@
+// block-uring.c
+
+#define _DEFAULT_SOURCE // syscall
+
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <linux/io_uring.h>
+#include <sys/syscall.h>
+#undef BLOCK_SIZE // linux/fs.h define el suyo; se usa el de vfs.h
+#endif
+
+#if defined(__linux__) && defined(__NR_io_uring_setup) && defined(__NR_io_uring_enter)
+#define HAVE_IO_URING 1
+#else
+#define HAVE_IO_URING 0
+#endif
+
+#include "vfs.h"
+
+/*
+    Motor asincronico de lectura de bloques
+
+    Permite tener varias lecturas de bloques "en vuelo" a la vez: vfs_aio_submit_read
+    encola la lectura y retorna un numero de ranura, y vfs_aio_complete espera a que
+    esa ranura termine. La cantidad de ranuras es la profundidad de la cola.
+
+    Si el kernel tiene io_uring, las lecturas se encolan en el anillo de envio y se
+    entregan al kernel todas juntas (vfs_aio_kick, o al esperar). Si no lo tiene (o
+    no se puede crear el anillo), las lecturas quedan pendientes y al esperar se leen
+    todas juntas con dev_read_blocks, de forma sincronica.
+
+    Los bloques que estan en el cache (o en la imagen mapeada) se copian al encolarlos,
+    para no leer de la imagen una version vieja de un bloque sucio.
+*/
+
+#define SLOT_FREE 0
+#define SLOT_QUEUED 1   // Pendiente de lectura sincronica (sin io_uring)
+#define SLOT_INFLIGHT 2 // Enviada a io_uring
+#define SLOT_DONE 3
+
+struct aio_slot {
+    int state;
+    int result; // 0 si la lectura fue completa, -1 si fallo
+    uint32_t block;
+    void *buffer;
+};
+
+struct vfs_aio {
+    struct vfs_dev *dev;
+    uint32_t depth;
+    uint32_t next_slot; // Por donde empezar a buscar una ranura libre
+    struct aio_slot *slots;
+    int ring_fd; // -1 si no se usa io_uring
+#if HAVE_IO_URING
+    uint32_t unsubmitted; // Lecturas en el anillo de envio que el kernel todavia no tomo
+    void *sq_ring;
+    size_t sq_ring_size;
+    void *cq_ring;
+    size_t cq_ring_size;
+    struct io_uring_sqe *sqes;
+    size_t sqes_size;
+    unsigned *sq_tail;
+    unsigned *sq_mask;
+    unsigned *sq_array;
+    unsigned *cq_head;
+    unsigned *cq_tail;
+    unsigned *cq_mask;
+    struct io_uring_cqe *cqes;
+#endif
+};
+
+static uint32_t default_depth = VFS_AIO_DEFAULT_DEPTH;
+
+void vfs_aio_set_depth(uint32_t depth) {
+    // Profundidad de cola de los motores que se creen de aqui en adelante
+    default_depth = depth > 0 ? depth : VFS_AIO_DEFAULT_DEPTH;
+}
+
+#if HAVE_IO_URING
+static int ring_setup(struct vfs_aio *aio) {
+    // Crea el anillo de io_uring y mapea sus colas. Retorna 0 o -1
+    struct io_uring_params params;
+    memset(&params, 0, sizeof(params));
+
+    int fd = (int)syscall(__NR_io_uring_setup, aio->depth, &params);
+    if (fd < 0)
+        return -1;
+
+    aio->sq_ring_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    aio->cq_ring_size = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    aio->sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+
+    aio->sq_ring = mmap(NULL, aio->sq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd,
+                        IORING_OFF_SQ_RING);
+    aio->cq_ring = mmap(NULL, aio->cq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd,
+                        IORING_OFF_CQ_RING);
+    aio->sqes = mmap(NULL, aio->sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+
+    if (aio->sq_ring == MAP_FAILED || aio->cq_ring == MAP_FAILED || aio->sqes == MAP_FAILED) {
+        if (aio->sq_ring != MAP_FAILED)
+            munmap(aio->sq_ring, aio->sq_ring_size);
+        if (aio->cq_ring != MAP_FAILED)
+            munmap(aio->cq_ring, aio->cq_ring_size);
+        if (aio->sqes != MAP_FAILED)
+            munmap(aio->sqes, aio->sqes_size);
+        close(fd);
+        return -1;
+    }
+
+    uint8_t *sq = aio->sq_ring;
+    uint8_t *cq = aio->cq_ring;
+    aio->sq_tail = (unsigned *)(sq + params.sq_off.tail);
+    aio->sq_mask = (unsigned *)(sq + params.sq_off.ring_mask);
+    aio->sq_array = (unsigned *)(sq + params.sq_off.array);
+    aio->cq_head = (unsigned *)(cq + params.cq_off.head);
+    aio->cq_tail = (unsigned *)(cq + params.cq_off.tail);
+    aio->cq_mask = (unsigned *)(cq + params.cq_off.ring_mask);
+    aio->cqes = (struct io_uring_cqe *)(cq + params.cq_off.cqes);
+
+    aio->ring_fd = fd;
+    aio->unsubmitted = 0;
+    return 0;
+}
+
+static void ring_teardown(struct vfs_aio *aio) {
+    munmap(aio->sq_ring, aio->sq_ring_size);
+    munmap(aio->cq_ring, aio->cq_ring_size);
+    munmap(aio->sqes, aio->sqes_size);
+    close(aio->ring_fd);
+    aio->ring_fd = -1;
+}
+
+static int ring_enter(struct vfs_aio *aio, unsigned min_complete) {
+    // Entrega al kernel las lecturas encoladas y, si min_complete > 0, espera esa cantidad
+    // de terminaciones. Retorna 0 o -1
+    unsigned flags = min_complete > 0 ? IORING_ENTER_GETEVENTS : 0;
+    for (;;) {
+        long submitted = syscall(__NR_io_uring_enter, aio->ring_fd, aio->unsubmitted, min_complete, flags, NULL, 0);
+        if (submitted >= 0) {
+            aio->unsubmitted -= (uint32_t)submitted;
+            return 0;
+        }
+        if (errno != EINTR)
+            return -1;
+    }
+}
+
+static void ring_reap(struct vfs_aio *aio) {
+    // Recorre las terminaciones disponibles y marca sus ranuras como terminadas
+    unsigned head = *aio->cq_head;
+    unsigned tail = __atomic_load_n(aio->cq_tail, __ATOMIC_ACQUIRE);
+
+    while (head != tail) {
+        struct io_uring_cqe *cqe = &aio->cqes[head & *aio->cq_mask];
+        struct aio_slot *slot = &aio->slots[cqe->user_data];
+
+        if (cqe->res == BLOCK_SIZE) {
+            slot->result = 0;
+        }
+        else if (cqe->res == -EINVAL || cqe->res == -EOPNOTSUPP) {
+            // Kernel sin IORING_OP_READ: se lee de forma sincronica
+            slot->result = dev_pread_block(aio->dev, slot->block, slot->buffer);
+        }
+        else {
+            slot->result = -1;
+        }
+        slot->state = SLOT_DONE;
+        head++;
+    }
+
+    __atomic_store_n(aio->cq_head, head, __ATOMIC_RELEASE);
+}
+
+static void ring_queue_read(struct vfs_aio *aio, uint32_t slot_index) {
+    // Agrega la lectura de la ranura al anillo de envio (sin entregarla todavia al kernel)
+    struct aio_slot *slot = &aio->slots[slot_index];
+    unsigned tail = *aio->sq_tail;
+    unsigned index = tail & *aio->sq_mask;
+    struct io_uring_sqe *sqe = &aio->sqes[index];
+
+    memset(sqe, 0, sizeof(struct io_uring_sqe));
+    sqe->opcode = IORING_OP_READ;
+    sqe->fd = aio->dev->fd;
+    sqe->addr = (uint64_t)(uintptr_t)slot->buffer;
+    sqe->len = BLOCK_SIZE;
+    sqe->off = (uint64_t)slot->block * BLOCK_SIZE;
+    sqe->user_data = slot_index;
+
+    aio->sq_array[index] = index;
+    __atomic_store_n(aio->sq_tail, tail + 1, __ATOMIC_RELEASE);
+    aio->unsubmitted++;
+    slot->state = SLOT_INFLIGHT;
+}
+#endif
+
+struct vfs_aio *aio_create(struct vfs_dev *dev) {
+    // Crea el motor de lectura del dispositivo, con io_uring si esta disponible
+    // Retorna NULL si no hay memoria
+    struct vfs_aio *aio = calloc(1, sizeof(struct vfs_aio));
+    if (aio == NULL)
+        return NULL;
+
+    aio->dev = dev;
+    aio->depth = default_depth;
+    aio->ring_fd = -1;
+    aio->slots = calloc(aio->depth, sizeof(struct aio_slot));
+    if (aio->slots == NULL) {
+        free(aio);
+        return NULL;
+    }
+
+#if HAVE_IO_URING
+    if (dev->map == NULL && ring_setup(aio) != 0)
+        DEBUG_PRINT("io_uring no disponible (%s), se usan lecturas sincronicas\n", strerror(errno));
+#endif
+
+    return aio;
+}
+
+static void aio_drain(struct vfs_aio *aio) {
+    // Espera todas las lecturas en curso, descartando su resultado
+    for (uint32_t i = 0; i < aio->depth; i++) {
+        if (aio->slots[i].state != SLOT_FREE)
+            vfs_aio_complete(aio, i);
+    }
+}
+
+void aio_destroy(struct vfs_aio *aio) {
+    // Libera el motor; antes espera las lecturas en curso, porque el kernel escribe en sus buffers
+    if (aio == NULL)
+        return;
+
+    aio_drain(aio);
+#if HAVE_IO_URING
+    if (aio->ring_fd >= 0)
+        ring_teardown(aio);
+#endif
+    free(aio->slots);
+    free(aio);
+}
+
+struct vfs_aio *vfs_aio_get(const char *image_path) {
+    // Retorna el motor de lectura asociado a la imagen, creandolo la primera vez
+    // Retorna NULL en caso de error
+    struct vfs_dev *dev = vfs_open(image_path);
+    if (dev == NULL)
+        return NULL;
+
+    if (dev->aio == NULL)
+        dev->aio = aio_create(dev);
+
+    return dev->aio;
+}
+
+int vfs_aio_is_async(const struct vfs_aio *aio) {
+    // 1 si las lecturas realmente se hacen en paralelo con io_uring
+    return aio->ring_fd >= 0;
+}
+
+uint32_t vfs_aio_depth(const struct vfs_aio *aio) {
+    return aio->depth;
+}
+
+int vfs_aio_submit_read(struct vfs_aio *aio, uint32_t block_number, void *buffer) {
+    // Encola la lectura de block_number en buffer, que debe seguir valido hasta completarla
+    // Retorna el numero de ranura para vfs_aio_complete, o -1 si la cola esta llena (EBUSY)
+    uint32_t slot_index = aio->depth;
+    for (uint32_t i = 0; i < aio->depth; i++) {
+        uint32_t candidate = (aio->next_slot + i) % aio->depth;
+        if (aio->slots[candidate].state == SLOT_FREE) {
+            slot_index = candidate;
+            break;
+        }
+    }
+
+    if (slot_index == aio->depth) {
+        errno = EBUSY;
+        return -1;
+    }
+    aio->next_slot = (slot_index + 1) % aio->depth;
+
+    struct aio_slot *slot = &aio->slots[slot_index];
+    slot->block = block_number;
+    slot->buffer = buffer;
+
+    // Bloques en memoria: se copian ya, y la ranura queda terminada
+    struct vfs_dev *dev = aio->dev;
+    if (dev->map != NULL || (dev->cache != NULL && cache_lookup(dev, block_number, buffer))) {
+        slot->result = dev->map != NULL ? dev_read_block(dev, block_number, buffer) : 0;
+        slot->state = SLOT_DONE;
+        return slot_index;
+    }
+
+#if HAVE_IO_URING
+    if (aio->ring_fd >= 0) {
+        ring_queue_read(aio, slot_index);
+        return slot_index;
+    }
+#endif
+
+    slot->state = SLOT_QUEUED;
+    return slot_index;
+}
+
+int vfs_aio_kick(struct vfs_aio *aio) {
+    // Entrega al kernel las lecturas encoladas, sin esperarlas. Retorna 0 o -1
+#if HAVE_IO_URING
+    if (aio->ring_fd >= 0 && aio->unsubmitted > 0)
+        return ring_enter(aio, 0);
+#else
+    (void)aio;
+#endif
+    return 0;
+}
+
+static const struct aio_slot *sort_slots; // ranuras a las que apuntan los indices que ordena compare_queued
+
+static int compare_queued(const void *a, const void *b) {
+    // Ordena ranuras pendientes por numero de bloque, para leer los consecutivos juntos
+    uint32_t ba = sort_slots[*(const uint32_t *)a].block;
+    uint32_t bb = sort_slots[*(const uint32_t *)b].block;
+    return (ba > bb) - (ba < bb);
+}
+
+static void read_queued(struct vfs_aio *aio) {
+    // Sin io_uring: lee juntas todas las ranuras pendientes, agrupando bloques consecutivos
+    uint32_t queued[aio->depth];
+    uint32_t block_nums[aio->depth];
+    void *buffers[aio->depth];
+    uint32_t count = 0;
+
+    for (uint32_t i = 0; i < aio->depth; i++) {
+        if (aio->slots[i].state == SLOT_QUEUED)
+            queued[count++] = i;
+    }
+
+    sort_slots = aio->slots;
+    qsort(queued, count, sizeof(uint32_t), compare_queued);
+
+    for (uint32_t k = 0; k < count; k++) {
+        block_nums[k] = aio->slots[queued[k]].block;
+        buffers[k] = aio->slots[queued[k]].buffer;
+    }
+
+    int batch_ok = dev_read_blocks(aio->dev, block_nums, buffers, count) == 0;
+
+    for (uint32_t k = 0; k < count; k++) {
+        struct aio_slot *slot = &aio->slots[queued[k]];
+        // Si fallo la lectura en conjunto, se reintenta de a un bloque para saber cual fallo
+        slot->result = batch_ok ? 0 : dev_read_block(aio->dev, slot->block, slot->buffer);
+        slot->state = SLOT_DONE;
+    }
+}
+
+int vfs_aio_complete(struct vfs_aio *aio, int slot_index) {
+    // Espera a que termine la lectura de la ranura y la libera
+    // Retorna 0 si el bloque se leyo completo, -1 si hubo error
+    if (slot_index < 0 || (uint32_t)slot_index >= aio->depth || aio->slots[slot_index].state == SLOT_FREE) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    struct aio_slot *slot = &aio->slots[slot_index];
+
+    while (slot->state != SLOT_DONE) {
+        if (slot->state == SLOT_QUEUED) {
+            read_queued(aio);
+            continue;
+        }
+#if HAVE_IO_URING
+        ring_reap(aio);
+        if (slot->state == SLOT_DONE)
+            break;
+        if (ring_enter(aio, 1) != 0) {
+            fprintf(stderr, "Error esperando lecturas de io_uring: %s\n", strerror(errno));
+            return -1;
+        }
+#endif
+    }
+
+    int result = slot->result;
+    slot->state = SLOT_FREE;
+    return result;
+}
+
+int read_blocks_prefetch(const char *image_path, const uint32_t *block_numbers, void *const *buffers,
+                         uint32_t count) {
+    // Como read_blocks, pero con io_uring mantiene hasta la profundidad de la cola de lecturas
+    // en vuelo: a medida que termina cada bloque se encola el siguiente pendiente
+    // Sin io_uring equivale a read_blocks. Retorna 0 o -1
+    struct vfs_aio *aio = vfs_aio_get(image_path);
+    if (aio == NULL)
+        return -1;
+
+    if (!vfs_aio_is_async(aio))
+        return dev_read_blocks(aio->dev, block_numbers, buffers, count);
+
+    if (count == 0)
+        return 0;
+
+    uint32_t window = aio->depth < count ? aio->depth : count;
+    int slots[window];
+    uint32_t submitted = 0;
+    int result = 0;
+
+    for (; submitted < window; submitted++)
+        slots[submitted] = vfs_aio_submit_read(aio, block_numbers[submitted], buffers[submitted]);
+    vfs_aio_kick(aio);
+
+    for (uint32_t i = 0; i < count; i++) {
+        if (slots[i % window] < 0 || vfs_aio_complete(aio, slots[i % window]) != 0)
+            result = -1;
+
+        if (submitted < count) {
+            slots[submitted % window] = vfs_aio_submit_read(aio, block_numbers[submitted], buffers[submitted]);
+            submitted++;
+            vfs_aio_kick(aio);
+        }
+    }
+
+    return result;
+}
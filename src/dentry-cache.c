@@ -0,0 +1,106 @@
+// dentry-cache.c
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "vfs.h"
+
+/*
+    Cache de nombres (dentries) de una imagen
+
+    Guarda en memoria el resultado de buscar un nombre en un directorio: (nodo-I del
+    directorio, nombre) -> nodo-I, o 0 si el nombre no existe (entrada negativa). Asi,
+    resolver varias rutas bajo el mismo subdirectorio no vuelve a leer los directorios
+    intermedios, y buscar un nombre que ya se sabe que no esta no lee ningun bloque.
+
+    La tabla tiene VFS_DCACHE_ENTRIES entradas con correspondencia directa: cada par
+    (directorio, nombre) tiene una sola posicion posible y, si esta ocupada por otro, lo
+    reemplaza. add_dir_entry y remove_dir_entry la mantienen al dia, asi que nunca queda
+    una entrada vieja; se descarta entera en vfs_close.
+*/
+
+struct dentry {
+    uint32_t parent;              // Nodo-I del directorio, 0 si la entrada esta libre
+    uint32_t inode;               // Nodo-I del nombre, 0 si no existe (entrada negativa)
+    uint16_t mode;                // Modo del nodo-I, 0 si todavia no se leyo
+    char name[FILENAME_MAX_LEN];
+};
+
+struct dentry_cache {
+    struct dentry entries[VFS_DCACHE_ENTRIES];
+    struct vfs_dcache_stats stats;
+};
+
+static struct dentry_cache *dcache_get(const char *image_path) {
+    // Retorna el cache de nombres de la imagen, creandolo la primera vez
+    // Retorna NULL si no se pudo abrir la imagen o no hay memoria
+    struct vfs_dev *dev = vfs_open(image_path);
+    if (dev == NULL)
+        return NULL;
+
+    if (dev->dcache == NULL)
+        dev->dcache = calloc(1, sizeof(struct dentry_cache));
+    return dev->dcache;
+}
+
+static struct dentry *dcache_slot(struct dentry_cache *dcache, uint32_t parent, const char *name) {
+    // Unica posicion posible del par (parent, name)
+    uint32_t hash = dir_name_hash(name) ^ (parent * 0x9E3779B1u);
+    return &dcache->entries[hash & (VFS_DCACHE_ENTRIES - 1)];
+}
+
+int dcache_lookup(const char *image_path, uint32_t parent, const char *name, uint32_t *inode, uint16_t *mode) {
+    // Busca name en el directorio parent. Retorna 1 si estaba en el cache (con *inode en 0
+    // si se sabe que no existe) o 0 si hay que buscarlo en el directorio
+    struct dentry_cache *dcache = dcache_get(image_path);
+    if (dcache == NULL)
+        return 0;
+
+    struct dentry *d = dcache_slot(dcache, parent, name);
+    if (d->parent != parent || strncmp(d->name, name, FILENAME_MAX_LEN) != 0) {
+        dcache->stats.misses++;
+        return 0;
+    }
+
+    if (d->inode == 0)
+        dcache->stats.negative_hits++;
+    else
+        dcache->stats.hits++;
+    *inode = d->inode;
+    *mode = d->mode;
+    return 1;
+}
+
+void dcache_store(const char *image_path, uint32_t parent, const char *name, uint32_t inode, uint16_t mode) {
+    // Guarda que name en el directorio parent es el nodo-I inode (0 si no existe), con su
+    // modo si se conoce (0 si no)
+    struct dentry_cache *dcache = dcache_get(image_path);
+    if (dcache == NULL)
+        return;
+
+    struct dentry *d = dcache_slot(dcache, parent, name);
+    d->parent = parent;
+    d->inode = inode;
+    d->mode = mode;
+    strncpy(d->name, name, FILENAME_MAX_LEN);
+}
+
+void dcache_destroy(struct dentry_cache *dcache) {
+    free(dcache);
+}
+
+int vfs_dcache_stats(const char *image_path, struct vfs_dcache_stats *stats) {
+    // Copia en stats los contadores del cache de nombres de la imagen (en cero si no se uso)
+    // Retorna 0, o -1 si no se pudo abrir la imagen
+    struct vfs_dev *dev = vfs_open(image_path);
+    if (dev == NULL)
+        return -1;
+
+    if (dev->dcache != NULL)
+        *stats = dev->dcache->stats;
+    else
+        memset(stats, 0, sizeof(*stats));
+    return 0;
+}
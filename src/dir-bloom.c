@@ -0,0 +1,290 @@
+// dir-bloom.c
+
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "vfs.h"
+
+/*
+    Filtro de Bloom de los nombres de un directorio
+
+    Responde "seguro que no esta" sin leer el indice hash ni los bloques del directorio,
+    que es lo que pasa casi siempre al crear archivos nuevos (vfs-touch y vfs-copy buscan
+    el nombre antes de agregarlo). Ocupa unos 16 bits por nombre, contra 16 bytes por nombre
+    del indice hash, asi que con miles de nombres sus bloques siguen en el cache de bloques.
+
+    Se guarda en un nodo-I oculto, cuyo numero es bloom_inode de la cabecera del directorio.
+    El bloque 0 tiene la cabecera del filtro (struct bloom_header) y los demas los bits. Es
+    un filtro por bloques: el hash del nombre elige un bloque del filtro y dentro de el se
+    prenden BLOOM_BITS_PER_NAME bits, asi que probar un nombre lee un solo bloque de bits.
+
+    Los bits no se pueden apagar al borrar un nombre (podrian ser de otro): se cuentan los
+    borrados y, cuando son la mitad de los nombres, o cuando hay mas nombres que los que
+    admite el tamaño del filtro, se rearma entero recorriendo el directorio. vfs-fsck
+    tambien lo rearma.
+*/
+
+// Bits que se prenden por cada nombre
+#define BLOOM_BITS_PER_NAME 6
+
+// Nombres por bloque de bits (16 bits por nombre) antes de agrandar el filtro
+#define BLOOM_NAMES_PER_BLOCK (BLOCK_SIZE * 8 / 16)
+
+// Cabecera del filtro, en el bloque 0 de su nodo-I
+struct bloom_header {
+    uint32_t filter_blocks;  // Bloques de bits, a continuacion de la cabecera
+    uint32_t names;          // Nombres agregados desde que se armo (incluye los borrados)
+    uint32_t deleted;        // Nombres borrados desde que se armo (sus bits siguen prendidos)
+};
+
+static uint32_t bloom_hash2(const char *name) {
+    // Segundo hash del nombre (FNV-1a con otra base), para elegir los bits del bloque
+    uint32_t hash = 0x811C9DC5u ^ 0x5BD1E995u;
+    for (const unsigned char *p = (const unsigned char *)name; *p != '\0'; p++) {
+        hash ^= *p;
+        hash *= 16777619u;
+    }
+    return hash ^ (hash >> 15);
+}
+
+static void bloom_set(uint8_t *bits, const char *name) {
+    // Prende en el bloque de bits los del nombre
+    uint32_t h = bloom_hash2(name);
+    uint32_t step = (h >> 17) | 1;
+    for (int i = 0; i < BLOOM_BITS_PER_NAME; i++, h += step) {
+        uint32_t bit = h % (BLOCK_SIZE * 8);
+        bits[bit / 8] |= 1u << (bit % 8);
+    }
+}
+
+static int bloom_check(const uint8_t *bits, const char *name) {
+    // Retorna 1 si estan prendidos todos los bits del nombre
+    uint32_t h = bloom_hash2(name);
+    uint32_t step = (h >> 17) | 1;
+    for (int i = 0; i < BLOOM_BITS_PER_NAME; i++, h += step) {
+        uint32_t bit = h % (BLOCK_SIZE * 8);
+        if (!(bits[bit / 8] & (1u << (bit % 8))))
+            return 0;
+    }
+    return 1;
+}
+
+// Filtro abierto: su nodo-I oculto y su cabecera
+struct bloom {
+    struct inode in;
+    int header_block;
+    uint8_t header_buf[BLOCK_SIZE];
+    struct bloom_header *header;
+};
+
+static int bloom_open(struct bloom *b, const char *image_path, const struct dir_header *hdr) {
+    if (read_inode(image_path, hdr->bloom_inode, &b->in) != 0)
+        return -1;
+
+    b->header_block = get_block_number_at(image_path, &b->in, 0);
+    if (b->header_block <= 0 || read_block(image_path, b->header_block, b->header_buf) != 0) {
+        fprintf(stderr, "Error al leer la cabecera del filtro del directorio\n");
+        return -1;
+    }
+
+    b->header = (struct bloom_header *)b->header_buf;
+    if (b->header->filter_blocks == 0 || b->header->filter_blocks >= b->in.blocks) {
+        fprintf(stderr, "Error: el filtro del directorio (nodo-I %u) esta dañado\n", hdr->bloom_inode);
+        return -1;
+    }
+    return 0;
+}
+
+static int bloom_block(const char *image_path, struct bloom *b, const char *name) {
+    // Retorna el bloque de la imagen con los bits del nombre, o -1 en caso de error
+    uint32_t index = 1 + dir_name_hash(name) % b->header->filter_blocks;
+    int block_num = get_block_number_at(image_path, &b->in, index);
+    if (block_num <= 0) {
+        fprintf(stderr, "Error al buscar el bloque %u del filtro del directorio\n", index);
+        return -1;
+    }
+    return block_num;
+}
+
+int dir_bloom_test(const char *image_path, const struct dir_header *hdr, const char *name) {
+    // Retorna 0 si name seguro no esta en el directorio, 1 si puede estar (o si el
+    // directorio no tiene filtro), o -1 en caso de error
+    if (hdr->bloom_inode == 0)
+        return 1;
+
+    struct bloom b;
+    if (bloom_open(&b, image_path, hdr) != 0)
+        return -1;
+
+    int block_num = bloom_block(image_path, &b, name);
+    uint8_t bits[BLOCK_SIZE];
+    if (block_num < 0 || read_block(image_path, block_num, bits) != 0)
+        return -1;
+
+    return bloom_check(bits, name);
+}
+
+int dir_bloom_add(const char *image_path, struct inode *dir, struct dir_header *hdr, const char *name) {
+    // Agrega name al filtro. Si el directorio no tiene filtro, o ya tiene mas nombres que
+    // los que admite su tamaño, lo rearma entero (la entrada ya tiene que estar en el
+    // directorio). Actualiza hdr, que escribe el llamador. Retorna 0 o -1
+    if (hdr->bloom_inode == 0)
+        return dir_bloom_build(image_path, dir, hdr);
+
+    struct bloom b;
+    if (bloom_open(&b, image_path, hdr) != 0)
+        return -1;
+
+    if (b.header->names + 1 > b.header->filter_blocks * BLOOM_NAMES_PER_BLOCK)
+        return dir_bloom_build(image_path, dir, hdr);
+
+    int block_num = bloom_block(image_path, &b, name);
+    uint8_t bits[BLOCK_SIZE];
+    if (block_num < 0 || read_block(image_path, block_num, bits) != 0)
+        return -1;
+
+    bloom_set(bits, name);
+    b.header->names++;
+    if (write_block(image_path, block_num, bits) != 0 ||
+        write_block(image_path, b.header_block, b.header_buf) != 0) {
+        fprintf(stderr, "Error al escribir el filtro del directorio\n");
+        return -1;
+    }
+    return 0;
+}
+
+int dir_bloom_remove(const char *image_path, struct inode *dir, struct dir_header *hdr) {
+    // Cuenta un nombre borrado del directorio (ya sacado de sus bloques). Cuando los
+    // borrados son la mitad de los nombres del filtro, lo rearma para apagar sus bits
+    // Retorna 0 o -1
+    if (hdr->bloom_inode == 0)
+        return 0;
+
+    struct bloom b;
+    if (bloom_open(&b, image_path, hdr) != 0)
+        return -1;
+
+    b.header->deleted++;
+    if (b.header->deleted * 2 >= b.header->names)
+        return dir_bloom_build(image_path, dir, hdr);
+
+    if (write_block(image_path, b.header_block, b.header_buf) != 0) {
+        fprintf(stderr, "Error al escribir el filtro del directorio\n");
+        return -1;
+    }
+    return 0;
+}
+
+int dir_bloom_build(const char *image_path, struct inode *dir, struct dir_header *hdr) {
+    // Arma el filtro desde cero con todas las entradas del directorio y lo escribe en el
+    // nodo-I oculto (que se crea si el directorio no tenia filtro). Tiene lugar para el
+    // doble de los nombres actuales y nunca se achica. Actualiza hdr, que escribe el llamador
+    // Retorna 0 o -1
+    uint32_t count = 0;
+    struct block_iter it;
+    struct block_run run;
+
+    // Contar las entradas usadas, para saber el tamaño del filtro
+    int result = block_iter_init(&it, image_path, dir, 0);
+    while (result == 0 && (result = block_iter_next(&it, 0, &run)) > 0) {
+        result = 0;
+        for (uint32_t b = 0; b < run.len; b++) {
+            uint8_t buffer[BLOCK_SIZE];
+            if (read_block(image_path, run.start + b, buffer) != 0) {
+                result = -1;
+                break;
+            }
+
+            const struct dir_entry *entries = (const struct dir_entry *)buffer;
+            for (uint32_t j = 0; j < DIR_ENTRIES_PER_BLOCK; j++)
+                count += entries[j].inode != 0;
+        }
+    }
+
+    struct inode bloom_in = {0};
+    if (result == 0 && hdr->bloom_inode != 0 && read_inode(image_path, hdr->bloom_inode, &bloom_in) != 0)
+        result = -1;
+    if (result != 0) {
+        fprintf(stderr, "Error al recorrer el directorio para armar su filtro\n");
+        return -1;
+    }
+
+    uint32_t nblocks = (count * 2 + BLOOM_NAMES_PER_BLOCK - 1) / BLOOM_NAMES_PER_BLOCK;
+    if (nblocks == 0)
+        nblocks = 1;
+    if (bloom_in.blocks > nblocks + 1)
+        nblocks = bloom_in.blocks - 1;
+
+    // Cabecera y bits en memoria, y una segunda pasada por el directorio para prender los bits
+    uint8_t *filter = calloc(nblocks + 1, BLOCK_SIZE);
+    if (filter == NULL) {
+        fprintf(stderr, "Error: sin memoria para armar el filtro del directorio\n");
+        return -1;
+    }
+
+    struct bloom_header *header = (struct bloom_header *)filter;
+    header->filter_blocks = nblocks;
+    header->names = count;
+
+    result = block_iter_init(&it, image_path, dir, 0);
+    while (result == 0 && (result = block_iter_next(&it, 0, &run)) > 0) {
+        result = 0;
+        for (uint32_t b = 0; b < run.len; b++) {
+            uint8_t buffer[BLOCK_SIZE];
+            if (read_block(image_path, run.start + b, buffer) != 0) {
+                result = -1;
+                break;
+            }
+
+            const struct dir_entry *entries = (const struct dir_entry *)buffer;
+            for (uint32_t j = 0; j < DIR_ENTRIES_PER_BLOCK; j++) {
+                if (entries[j].inode == 0)
+                    continue;
+                uint32_t index = 1 + dir_name_hash(entries[j].name) % nblocks;
+                bloom_set(filter + (size_t)index * BLOCK_SIZE, entries[j].name);
+            }
+        }
+    }
+    if (result != 0) {
+        fprintf(stderr, "Error al recorrer el directorio para armar su filtro\n");
+        free(filter);
+        return -1;
+    }
+
+    if (hdr->bloom_inode == 0) {
+        int bloom_inode = create_empty_file_in_free_inode(image_path, 0600);
+        if (bloom_inode < 0) {
+            fprintf(stderr, "No hay nodos-I libres para el filtro del directorio\n");
+            free(filter);
+            return -1;
+        }
+        hdr->bloom_inode = bloom_inode;
+    }
+
+    size_t size = (size_t)(nblocks + 1) * BLOCK_SIZE;
+    result = inode_write_data(image_path, hdr->bloom_inode, filter, size, 0) == (int)size ? 0 : -1;
+    free(filter);
+    if (result != 0) {
+        fprintf(stderr, "Error al escribir el filtro del directorio\n");
+        return -1;
+    }
+
+    DEBUG_PRINT("Filtro del directorio armado: %u nombres en %u bloques (nodo-I %u)\n", count, nblocks,
+                hdr->bloom_inode);
+    return 0;
+}
+
+void dir_bloom_drop(const char *image_path, struct dir_header *hdr) {
+    // Descarta el filtro: libera su nodo-I y sus bloques y deja hdr sin filtro
+    if (hdr->bloom_inode != 0) {
+        struct inode in;
+        if (read_inode(image_path, hdr->bloom_inode, &in) != 0 || inode_trunc_data(image_path, &in) != 0 ||
+            free_inode(image_path, hdr->bloom_inode) != 0)
+            fprintf(stderr, "Error al liberar el filtro del directorio (nodo-I %u)\n", hdr->bloom_inode);
+    }
+
+    hdr->bloom_inode = 0;
+}
@@ -0,0 +1,369 @@
+// dir-hash.c
+
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "vfs.h"
+
+/*
+    Indice hash de los nombres de un directorio
+
+    Las entradas siguen en los bloques del directorio como siempre (vfs-ls las recorre igual);
+    el indice es una tabla hash con direccionamiento abierto y sondeo lineal, guardada en los
+    bloques de un nodo-I oculto que no figura en ningun directorio. Su numero y sus contadores
+    estan en la cabecera del directorio (struct dir_header, dentro de la entrada ".").
+
+    Cada posicion de la tabla es un uint32_t: 0 si esta libre, HASH_DELETED si se borro, o
+    (etiqueta << HASH_LOC_BITS) | posicion de la entrada en el directorio (DIR_LOC), donde la
+    etiqueta son los 11 bits altos del hash del nombre. Buscar, agregar o borrar un nombre lee
+    el bloque de la tabla donde cae su hash y, salvo que coincidan etiquetas, un solo bloque
+    del directorio, sin importar cuantas entradas tenga.
+
+    La tabla se mantiene a lo sumo a medio llenar (contando las borradas); al pasarse se
+    reconstruye recorriendo el directorio, con el doble de bloques si hace falta.
+*/
+
+// Posiciones de la tabla en cada bloque del indice
+#define HASH_SLOTS_PER_BLOCK (BLOCK_SIZE / sizeof(uint32_t))
+
+// Valor de una posicion borrada (las libres valen 0)
+#define HASH_DELETED 0xFFFFFFFFu
+
+// Bits del valor con la posicion de la entrada; los de arriba son la etiqueta
+#define HASH_LOC_BITS 21
+#define HASH_LOC_MASK ((1u << HASH_LOC_BITS) - 1)
+
+// Tabla del indice abierta, que se lee y escribe de a un bloque
+struct hash_table {
+    const char *image_path;
+    struct inode in;                     // Nodo-I oculto del indice
+    uint32_t slots;                      // Cantidad de posiciones de la tabla
+    uint32_t block;                      // Bloque de la tabla cargado en buf, UINT32_MAX si ninguno
+    int block_num;                       // Numero de ese bloque en la imagen
+    uint32_t buf[HASH_SLOTS_PER_BLOCK];
+};
+
+uint32_t dir_name_hash(const char *name) {
+    // Hash FNV-1a de 32 bits del nombre (hasta FILENAME_MAX_LEN caracteres)
+    uint32_t hash = 2166136261u;
+    for (int i = 0; i < FILENAME_MAX_LEN && name[i] != '\0'; i++) {
+        hash ^= (uint8_t)name[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+static uint32_t hash_value(uint32_t hash, uint32_t loc) {
+    // Valor a guardar en la tabla: etiqueta (nunca 0) y posicion de la entrada
+    return (((hash >> HASH_LOC_BITS) | 1) << HASH_LOC_BITS) | loc;
+}
+
+int dir_header_read(const char *image_path, uint32_t dir_inode, struct inode *dir, struct dir_header *hdr) {
+    // Lee la cabecera del directorio dir (nodo-I nro dir_inode) de su entrada "."
+    // Retorna 1 si la leyo, 0 si el directorio no empieza con "." (no tiene cabecera),
+    // o -1 en caso de error
+    int block_num = get_block_number_at(image_path, dir, 0);
+    if (block_num <= 0)
+        return block_num < 0 ? -1 : 0;
+
+    uint8_t buffer[BLOCK_SIZE];
+    if (read_block(image_path, block_num, buffer) != 0)
+        return -1;
+
+    const struct dir_entry *entries = (const struct dir_entry *)buffer;
+    if (entries[0].inode != dir_inode || strcmp(entries[0].name, ".") != 0)
+        return 0;
+
+    memcpy(hdr, entries[0].name, sizeof(struct dir_header));
+    return 1;
+}
+
+int dir_header_write(const char *image_path, struct inode *dir, const struct dir_header *hdr) {
+    // Guarda la cabecera en la entrada "." del directorio. Retorna 0 o -1
+    int block_num = get_block_number_at(image_path, dir, 0);
+    if (block_num <= 0)
+        return -1;
+
+    uint8_t buffer[BLOCK_SIZE];
+    if (read_block(image_path, block_num, buffer) != 0)
+        return -1;
+
+    struct dir_entry *entries = (struct dir_entry *)buffer;
+    memcpy(entries[0].name, hdr, sizeof(struct dir_header));
+    return write_block(image_path, block_num, buffer);
+}
+
+static int table_open(struct hash_table *t, const char *image_path, const struct dir_header *hdr) {
+    // Prepara el acceso a la tabla del indice de hdr. Retorna 0 o -1
+    t->image_path = image_path;
+    t->block = UINT32_MAX;
+    if (read_inode(image_path, hdr->index_inode, &t->in) != 0)
+        return -1;
+
+    t->slots = t->in.blocks * HASH_SLOTS_PER_BLOCK;
+    if (t->slots == 0) {
+        fprintf(stderr, "Error: el indice del directorio (nodo-I %u) esta vacio\n", hdr->index_inode);
+        return -1;
+    }
+    return 0;
+}
+
+static uint32_t *table_slot(struct hash_table *t, uint32_t pos) {
+    // Retorna la posicion pos de la tabla, leyendo su bloque si no es el cargado
+    // Retorna NULL en caso de error
+    uint32_t block = pos / HASH_SLOTS_PER_BLOCK;
+    if (block != t->block) {
+        int block_num = get_block_number_at(t->image_path, &t->in, block);
+        if (block_num <= 0 || read_block(t->image_path, block_num, t->buf) != 0) {
+            fprintf(stderr, "Error al leer el bloque %u del indice del directorio\n", block);
+            return NULL;
+        }
+        t->block = block;
+        t->block_num = block_num;
+    }
+    return &t->buf[pos % HASH_SLOTS_PER_BLOCK];
+}
+
+static int table_store(struct hash_table *t) {
+    // Escribe el bloque cargado de la tabla. Retorna 0 o -1
+    if (write_block(t->image_path, t->block_num, t->buf) != 0) {
+        fprintf(stderr, "Error al escribir el bloque %u del indice del directorio\n", t->block);
+        return -1;
+    }
+    return 0;
+}
+
+static int entry_at(const char *image_path, struct inode *dir, uint32_t loc, const char *name) {
+    // Retorna el nodo-I de la entrada loc del directorio si se llama name, 0 si no, o -1
+    int block_num = get_block_number_at(image_path, dir, loc / DIR_ENTRIES_PER_BLOCK);
+    if (block_num <= 0)
+        return -1;
+
+    uint8_t buffer[BLOCK_SIZE];
+    if (read_block(image_path, block_num, buffer) != 0)
+        return -1;
+
+    const struct dir_entry *entry = (const struct dir_entry *)buffer + loc % DIR_ENTRIES_PER_BLOCK;
+    if (entry->inode == 0 || strncmp(entry->name, name, FILENAME_MAX_LEN) != 0)
+        return 0;
+    return entry->inode;
+}
+
+int dir_hash_find(const char *image_path, struct inode *dir, const struct dir_header *hdr, const char *name,
+                  uint32_t *loc) {
+    // Busca name con el indice del directorio
+    // Retorna el nodo-I de la entrada (y en *loc su posicion), 0 si no esta, o -1 en caso de error
+    struct hash_table t;
+    if (table_open(&t, image_path, hdr) != 0)
+        return -1;
+
+    uint32_t hash = dir_name_hash(name);
+    uint32_t tag = hash_value(hash, 0);
+    uint32_t pos = hash % t.slots;
+
+    for (uint32_t i = 0; i < t.slots; i++, pos = (pos + 1) % t.slots) {
+        uint32_t *slot = table_slot(&t, pos);
+        if (slot == NULL)
+            return -1;
+        if (*slot == 0)
+            return 0;
+        if (*slot == HASH_DELETED || (*slot & ~HASH_LOC_MASK) != tag)
+            continue;
+
+        int inode = entry_at(image_path, dir, *slot & HASH_LOC_MASK, name);
+        if (inode != 0) {
+            *loc = *slot & HASH_LOC_MASK;
+            return inode;
+        }
+    }
+
+    return 0;
+}
+
+int dir_hash_insert(const char *image_path, struct inode *dir, struct dir_header *hdr, const char *name,
+                    uint32_t loc) {
+    // Agrega al indice la entrada name, ya escrita en la posicion loc del directorio.
+    // Si el directorio no tiene indice, o la tabla quedaria mas que a medio llenar, lo
+    // reconstruye entero (ya con la entrada nueva). Actualiza hdr, que escribe el llamador
+    // Retorna 0 o -1
+    if (hdr->index_inode == 0)
+        return dir_hash_build(image_path, dir, hdr);
+
+    struct hash_table t;
+    if (table_open(&t, image_path, hdr) != 0)
+        return -1;
+
+    if ((hdr->index_used + hdr->index_deleted + 1) * 2 > t.slots)
+        return dir_hash_build(image_path, dir, hdr);
+
+    uint32_t hash = dir_name_hash(name);
+    uint32_t pos = hash % t.slots;
+
+    for (uint32_t i = 0; i < t.slots; i++, pos = (pos + 1) % t.slots) {
+        uint32_t *slot = table_slot(&t, pos);
+        if (slot == NULL)
+            return -1;
+        if (*slot != 0 && *slot != HASH_DELETED)
+            continue;
+
+        if (*slot == HASH_DELETED)
+            hdr->index_deleted--;
+        *slot = hash_value(hash, loc);
+        hdr->index_used++;
+        return table_store(&t);
+    }
+
+    // No deberia pasar: la tabla nunca se llena
+    fprintf(stderr, "Error: el indice del directorio esta lleno\n");
+    return -1;
+}
+
+int dir_hash_remove(const char *image_path, struct dir_header *hdr, const char *name, uint32_t loc) {
+    // Marca como borrada la posicion del indice que apunta a la entrada loc (de nombre name)
+    // Actualiza hdr, que escribe el llamador. Retorna 0 (tambien si no estaba) o -1
+    if (hdr->index_inode == 0)
+        return 0;
+
+    struct hash_table t;
+    if (table_open(&t, image_path, hdr) != 0)
+        return -1;
+
+    uint32_t hash = dir_name_hash(name);
+    uint32_t value = hash_value(hash, loc);
+    uint32_t pos = hash % t.slots;
+
+    for (uint32_t i = 0; i < t.slots; i++, pos = (pos + 1) % t.slots) {
+        uint32_t *slot = table_slot(&t, pos);
+        if (slot == NULL)
+            return -1;
+        if (*slot == 0)
+            break;
+        if (*slot != value)
+            continue;
+
+        *slot = HASH_DELETED;
+        hdr->index_used--;
+        hdr->index_deleted++;
+        return table_store(&t);
+    }
+
+    DEBUG_PRINT("'%s' no estaba en el indice del directorio\n", name);
+    return 0;
+}
+
+int dir_hash_build(const char *image_path, struct inode *dir, struct dir_header *hdr) {
+    // Arma el indice desde cero con todas las entradas del directorio y lo escribe en el
+    // nodo-I oculto (que se crea si el directorio no tenia indice). La tabla tiene al menos
+    // cuatro posiciones por entrada y nunca se achica. Actualiza hdr, que escribe el llamador
+    // Retorna 0 o -1
+    uint32_t max_entries = dir->blocks * DIR_ENTRIES_PER_BLOCK;
+    uint32_t *hashes = malloc(max_entries * sizeof(uint32_t));
+    uint32_t *locs = malloc(max_entries * sizeof(uint32_t));
+    if (hashes == NULL || locs == NULL) {
+        fprintf(stderr, "Error: sin memoria para armar el indice del directorio\n");
+        free(hashes);
+        free(locs);
+        return -1;
+    }
+
+    // Juntar hash y posicion de cada entrada usada
+    uint32_t count = 0;
+    uint32_t index = 0;
+    struct block_iter it;
+    struct block_run run;
+    int result = block_iter_init(&it, image_path, dir, 0);
+    while (result == 0 && (result = block_iter_next(&it, 0, &run)) > 0) {
+        result = 0;
+        for (uint32_t b = 0; b < run.len && result == 0; b++, index++) {
+            uint8_t buffer[BLOCK_SIZE];
+            if (read_block(image_path, run.start + b, buffer) != 0) {
+                result = -1;
+                break;
+            }
+
+            const struct dir_entry *entries = (const struct dir_entry *)buffer;
+            for (uint32_t j = 0; j < DIR_ENTRIES_PER_BLOCK; j++) {
+                if (entries[j].inode == 0)
+                    continue;
+                hashes[count] = dir_name_hash(entries[j].name);
+                locs[count++] = DIR_LOC(index, j);
+            }
+        }
+    }
+
+    struct inode index_in = {0};
+    if (result == 0 && hdr->index_inode != 0 && read_inode(image_path, hdr->index_inode, &index_in) != 0)
+        result = -1;
+
+    if (result != 0) {
+        fprintf(stderr, "Error al recorrer el directorio para armar su indice\n");
+        free(hashes);
+        free(locs);
+        return -1;
+    }
+
+    // Tamaño de la tabla en bloques: el actual, duplicado hasta que sobre lugar
+    uint32_t nblocks = index_in.blocks > 0 ? index_in.blocks : 1;
+    while ((uint64_t)count * 4 > (uint64_t)nblocks * HASH_SLOTS_PER_BLOCK)
+        nblocks *= 2;
+
+    uint32_t slots = nblocks * HASH_SLOTS_PER_BLOCK;
+    uint32_t *table = calloc(slots, sizeof(uint32_t));
+    if (table == NULL) {
+        fprintf(stderr, "Error: sin memoria para armar el indice del directorio\n");
+        free(hashes);
+        free(locs);
+        return -1;
+    }
+
+    for (uint32_t k = 0; k < count; k++) {
+        uint32_t pos = hashes[k] % slots;
+        while (table[pos] != 0)
+            pos = (pos + 1) % slots;
+        table[pos] = hash_value(hashes[k], locs[k]);
+    }
+    free(hashes);
+    free(locs);
+
+    if (hdr->index_inode == 0) {
+        int index_inode = create_empty_file_in_free_inode(image_path, 0600);
+        if (index_inode < 0) {
+            fprintf(stderr, "No hay nodos-I libres para el indice del directorio\n");
+            free(table);
+            return -1;
+        }
+        hdr->index_inode = index_inode;
+    }
+
+    size_t size = (size_t)slots * sizeof(uint32_t);
+    result = inode_write_data(image_path, hdr->index_inode, table, size, 0) == (int)size ? 0 : -1;
+    free(table);
+    if (result != 0) {
+        fprintf(stderr, "Error al escribir el indice del directorio\n");
+        return -1;
+    }
+
+    hdr->index_used = count;
+    hdr->index_deleted = 0;
+    DEBUG_PRINT("Indice del directorio armado: %u entradas en %u bloques (nodo-I %u)\n", count, nblocks,
+                hdr->index_inode);
+    return 0;
+}
+
+void dir_hash_drop(const char *image_path, struct dir_header *hdr) {
+    // Descarta el indice (por ejemplo, si no se pudo actualizar): libera su nodo-I y sus
+    // bloques y deja hdr sin indice. Las busquedas vuelven a recorrer el directorio
+    if (hdr->index_inode != 0) {
+        struct inode in;
+        if (read_inode(image_path, hdr->index_inode, &in) != 0 || inode_trunc_data(image_path, &in) != 0 ||
+            free_inode(image_path, hdr->index_inode) != 0)
+            fprintf(stderr, "Error al liberar el indice del directorio (nodo-I %u)\n", hdr->index_inode);
+    }
+
+    hdr->index_inode = 0;
+    hdr->index_used = 0;
+    hdr->index_deleted = 0;
+}
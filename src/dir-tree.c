@@ -0,0 +1,499 @@
+// dir-tree.c
+
+#define _POSIX_C_SOURCE 200809L // strnlen
+
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "vfs.h"
+
+/*
+    Arbol B+ de los nombres de un directorio
+
+    Igual que el indice hash (dir-hash.c), el arbol es una copia de las entradas del
+    directorio guardada en un nodo-I oculto, cuyo numero esta en la cabecera del directorio
+    (tree_inode). Mantiene las entradas (struct dir_entry) ordenadas por nombre, asi un
+    listado ordenado recorre las hojas en orden sin ordenar nada, y listar desde un prefijo
+    baja una sola vez por el arbol.
+
+    Cada nodo ocupa un bloque del nodo-I oculto y se identifica por su posicion en el
+    (el nodo 0 es siempre la raiz). El primer registro del bloque es la cabecera del nodo y
+    los demas son dir_entry:
+      - en una hoja, las entradas del directorio ordenadas por nombre; las hojas estan
+        encadenadas en orden con next
+      - en un nodo interno, rec[i].inode es el nodo hijo i y rec[i].name el menor nombre
+        que puede estar en ese hijo (el de rec[0] no se usa)
+
+    Al borrar no se juntan nodos: una hoja puede quedar con pocas entradas o vacia, y el
+    recorrido las saltea. El arbol se rearma entero (lleno al 75%) con dir_tree_build.
+*/
+
+// Registros por nodo (el primero del bloque es la cabecera)
+#define TREE_RECORDS (DIR_ENTRIES_PER_BLOCK - 1)
+
+// Registros por hoja al rearmar el arbol, para que las inserciones no partan enseguida
+#define TREE_BUILD_FILL (TREE_RECORDS * 3 / 4)
+
+// Profundidad maxima del arbol (con 31 registros por nodo alcanza con mucho)
+#define TREE_MAX_DEPTH 16
+
+struct tree_node_head {
+    uint16_t leaf;   // 1 si es una hoja
+    uint16_t count;  // Registros usados
+    uint32_t next;   // En una hoja: nodo de la hoja siguiente, 0 si es la ultima
+    uint8_t reserved[sizeof(struct dir_entry) - 8];
+};
+
+struct tree_node {
+    struct tree_node_head head;
+    struct dir_entry rec[TREE_RECORDS];
+};
+
+// Arbol abierto: el nodo-I oculto, para ubicar los bloques de los nodos
+struct tree {
+    const char *image_path;
+    uint32_t inode_nbr;
+    struct inode in;
+};
+
+static int tree_open(struct tree *t, const char *image_path, uint32_t inode_nbr) {
+    t->image_path = image_path;
+    t->inode_nbr = inode_nbr;
+    if (read_inode(image_path, inode_nbr, &t->in) != 0)
+        return -1;
+    if (t->in.blocks == 0) {
+        fprintf(stderr, "Error: el arbol del directorio (nodo-I %u) esta vacio\n", inode_nbr);
+        return -1;
+    }
+    return 0;
+}
+
+static int node_read(struct tree *t, uint32_t node, struct tree_node *buf) {
+    // Lee el nodo nro node. Retorna 0 o -1
+    int block_num = get_block_number_at(t->image_path, &t->in, node);
+    if (block_num <= 0 || read_block(t->image_path, block_num, buf) != 0) {
+        fprintf(stderr, "Error al leer el nodo %u del arbol del directorio\n", node);
+        return -1;
+    }
+    return 0;
+}
+
+static int node_write(struct tree *t, uint32_t node, const struct tree_node *buf) {
+    // Escribe el nodo nro node. Retorna 0 o -1
+    int block_num = get_block_number_at(t->image_path, &t->in, node);
+    if (block_num <= 0 || write_block(t->image_path, block_num, buf) != 0) {
+        fprintf(stderr, "Error al escribir el nodo %u del arbol del directorio\n", node);
+        return -1;
+    }
+    return 0;
+}
+
+static int node_append(struct tree *t, const struct tree_node *buf) {
+    // Agrega un nodo al final del arbol con el contenido de buf
+    // Retorna el numero del nodo nuevo, o -1 en caso de error
+    uint32_t node = t->in.blocks;
+    if (inode_write_data(t->image_path, t->inode_nbr, (void *)buf, BLOCK_SIZE, (size_t)node * BLOCK_SIZE) !=
+            BLOCK_SIZE ||
+        read_inode(t->image_path, t->inode_nbr, &t->in) != 0) {
+        fprintf(stderr, "Error al agregar un nodo al arbol del directorio\n");
+        return -1;
+    }
+    return node;
+}
+
+static int key_cmp(const char *a, const char *b) {
+    return strncmp(a, b, FILENAME_MAX_LEN);
+}
+
+static uint32_t child_index(const struct tree_node *node, const char *name) {
+    // En un nodo interno, el hijo donde puede estar name: el ultimo con clave <= name
+    uint32_t lo = 1, hi = node->head.count;
+    while (lo < hi) {
+        uint32_t mid = (lo + hi) / 2;
+        if (key_cmp(node->rec[mid].name, name) <= 0)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return lo - 1;
+}
+
+static uint32_t leaf_position(const struct tree_node *node, const char *name) {
+    // En una hoja, la posicion del primer registro con nombre >= name
+    uint32_t lo = 0, hi = node->head.count;
+    while (lo < hi) {
+        uint32_t mid = (lo + hi) / 2;
+        if (key_cmp(node->rec[mid].name, name) < 0)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return lo;
+}
+
+static void make_record(struct dir_entry *rec, uint32_t inode, const char *name) {
+    // Arma un registro con el nombre completado con ceros
+    rec->inode = inode;
+    memset(rec->name, 0, FILENAME_MAX_LEN);
+    memcpy(rec->name, name, strnlen(name, FILENAME_MAX_LEN));
+}
+
+static int insert_at(struct tree *t, uint32_t node_nbr, struct tree_node *node, uint32_t pos,
+                     const struct dir_entry *rec, struct dir_entry *promoted) {
+    // Inserta rec en la posicion pos del nodo. Si el nodo esta lleno lo parte en dos:
+    // la mitad de arriba pasa a un nodo nuevo, que se devuelve en promoted (su numero y
+    // su menor clave) para agregarlo al padre. Retorna 1 si partio el nodo, 0 si no, o -1
+    if (node->head.count < TREE_RECORDS) {
+        memmove(&node->rec[pos + 1], &node->rec[pos], (node->head.count - pos) * sizeof(struct dir_entry));
+        node->rec[pos] = *rec;
+        node->head.count++;
+        return node_write(t, node_nbr, node);
+    }
+
+    // Todos los registros, con el nuevo, en orden
+    struct dir_entry all[TREE_RECORDS + 1];
+    memcpy(all, node->rec, pos * sizeof(struct dir_entry));
+    all[pos] = *rec;
+    memcpy(&all[pos + 1], &node->rec[pos], (TREE_RECORDS - pos) * sizeof(struct dir_entry));
+
+    uint32_t left_count = (TREE_RECORDS + 1) / 2;
+    struct tree_node right;
+    memset(&right, 0, sizeof(right));
+    right.head.leaf = node->head.leaf;
+    right.head.count = TREE_RECORDS + 1 - left_count;
+    memcpy(right.rec, &all[left_count], right.head.count * sizeof(struct dir_entry));
+
+    node->head.count = left_count;
+    memcpy(node->rec, all, left_count * sizeof(struct dir_entry));
+    memset(&node->rec[left_count], 0, (TREE_RECORDS - left_count) * sizeof(struct dir_entry));
+
+    // La raiz sigue en el nodo 0: sus dos mitades pasan a nodos nuevos
+    if (node_nbr == 0) {
+        struct tree_node left = *node;
+        int right_nbr = node_append(t, &right);
+        if (right_nbr < 0)
+            return -1;
+        if (left.head.leaf)
+            left.head.next = right_nbr;
+        int left_nbr = node_append(t, &left);
+        if (left_nbr < 0)
+            return -1;
+
+        memset(node, 0, sizeof(*node));
+        node->head.leaf = 0;
+        node->head.count = 2;
+        make_record(&node->rec[0], left_nbr, "");
+        make_record(&node->rec[1], right_nbr, right.rec[0].name);
+        return node_write(t, 0, node);
+    }
+
+    if (right.head.leaf)
+        right.head.next = node->head.next;
+    int right_nbr = node_append(t, &right);
+    if (right_nbr < 0)
+        return -1;
+    if (node->head.leaf)
+        node->head.next = right_nbr;
+    if (node_write(t, node_nbr, node) != 0)
+        return -1;
+
+    make_record(promoted, right_nbr, right.rec[0].name);
+    return 1;
+}
+
+int dir_tree_insert(const char *image_path, struct inode *dir, struct dir_header *hdr, const char *name,
+                    uint32_t inode_number) {
+    // Agrega al arbol la entrada name -> inode_number. Si el directorio no tiene arbol,
+    // lo arma entero (la entrada ya tiene que estar en el directorio)
+    // Actualiza hdr, que escribe el llamador. Retorna 0 o -1
+    if (hdr->tree_inode == 0)
+        return dir_tree_build(image_path, dir, hdr);
+
+    struct tree t;
+    if (tree_open(&t, image_path, hdr->tree_inode) != 0)
+        return -1;
+
+    // Bajar hasta la hoja, recordando el camino
+    uint32_t path_nodes[TREE_MAX_DEPTH];
+    uint32_t path_index[TREE_MAX_DEPTH];
+    int depth = 0;
+    uint32_t node_nbr = 0;
+    struct tree_node node;
+
+    if (node_read(&t, node_nbr, &node) != 0)
+        return -1;
+    while (!node.head.leaf) {
+        if (depth == TREE_MAX_DEPTH || node.head.count == 0) {
+            fprintf(stderr, "Error: el arbol del directorio esta dañado\n");
+            return -1;
+        }
+        uint32_t i = child_index(&node, name);
+        path_nodes[depth] = node_nbr;
+        path_index[depth++] = i;
+        node_nbr = node.rec[i].inode;
+        if (node_read(&t, node_nbr, &node) != 0)
+            return -1;
+    }
+
+    struct dir_entry rec;
+    make_record(&rec, inode_number, name);
+
+    uint32_t pos = leaf_position(&node, name);
+    if (pos < node.head.count && key_cmp(node.rec[pos].name, name) == 0) {
+        // Ya estaba: solo se actualiza el nodo-I
+        node.rec[pos].inode = inode_number;
+        return node_write(&t, node_nbr, &node);
+    }
+
+    // Insertar y subir las particiones mientras haga falta
+    struct dir_entry promoted;
+    int result = insert_at(&t, node_nbr, &node, pos, &rec, &promoted);
+    while (result == 1) {
+        depth--;
+        node_nbr = path_nodes[depth];
+        if (node_read(&t, node_nbr, &node) != 0)
+            return -1;
+        rec = promoted;
+        result = insert_at(&t, node_nbr, &node, path_index[depth] + 1, &rec, &promoted);
+    }
+
+    return result;
+}
+
+int dir_tree_remove(const char *image_path, struct dir_header *hdr, const char *name) {
+    // Quita name del arbol (sin juntar nodos). Retorna 0 (tambien si no estaba) o -1
+    if (hdr->tree_inode == 0)
+        return 0;
+
+    struct tree t;
+    if (tree_open(&t, image_path, hdr->tree_inode) != 0)
+        return -1;
+
+    uint32_t node_nbr = 0;
+    struct tree_node node;
+    if (node_read(&t, node_nbr, &node) != 0)
+        return -1;
+    for (int depth = 0; !node.head.leaf; depth++) {
+        if (depth == TREE_MAX_DEPTH || node.head.count == 0) {
+            fprintf(stderr, "Error: el arbol del directorio esta dañado\n");
+            return -1;
+        }
+        node_nbr = node.rec[child_index(&node, name)].inode;
+        if (node_read(&t, node_nbr, &node) != 0)
+            return -1;
+    }
+
+    uint32_t pos = leaf_position(&node, name);
+    if (pos == node.head.count || key_cmp(node.rec[pos].name, name) != 0) {
+        DEBUG_PRINT("'%s' no estaba en el arbol del directorio\n", name);
+        return 0;
+    }
+
+    node.head.count--;
+    memmove(&node.rec[pos], &node.rec[pos + 1], (node.head.count - pos) * sizeof(struct dir_entry));
+    memset(&node.rec[node.head.count], 0, sizeof(struct dir_entry));
+    return node_write(&t, node_nbr, &node);
+}
+
+static int compare_records(const void *a, const void *b) {
+    return key_cmp(((const struct dir_entry *)a)->name, ((const struct dir_entry *)b)->name);
+}
+
+int dir_tree_build(const char *image_path, struct inode *dir, struct dir_header *hdr) {
+    // Arma el arbol desde cero con todas las entradas del directorio, con las hojas llenas
+    // al 75%, y lo escribe en el nodo-I oculto (que se crea si el directorio no tenia arbol)
+    // Actualiza hdr, que escribe el llamador. Retorna 0 o -1
+    uint32_t max_entries = dir->blocks * DIR_ENTRIES_PER_BLOCK;
+    struct dir_entry *records = malloc((max_entries > 0 ? max_entries : 1) * sizeof(struct dir_entry));
+    if (records == NULL) {
+        fprintf(stderr, "Error: sin memoria para armar el arbol del directorio\n");
+        return -1;
+    }
+
+    // Juntar las entradas usadas (el nombre de "." sin la cabecera)
+    uint32_t count = 0;
+    struct block_iter it;
+    struct block_run run;
+    int result = block_iter_init(&it, image_path, dir, 0);
+    while (result == 0 && (result = block_iter_next(&it, 0, &run)) > 0) {
+        result = 0;
+        for (uint32_t b = 0; b < run.len; b++) {
+            uint8_t buffer[BLOCK_SIZE];
+            if (read_block(image_path, run.start + b, buffer) != 0) {
+                result = -1;
+                break;
+            }
+
+            const struct dir_entry *entries = (const struct dir_entry *)buffer;
+            for (uint32_t j = 0; j < DIR_ENTRIES_PER_BLOCK; j++) {
+                if (entries[j].inode != 0)
+                    make_record(&records[count++], entries[j].inode, entries[j].name);
+            }
+        }
+    }
+    if (result != 0) {
+        fprintf(stderr, "Error al recorrer el directorio para armar su arbol\n");
+        free(records);
+        return -1;
+    }
+
+    qsort(records, count, sizeof(struct dir_entry), compare_records);
+
+    // Nodos del arbol en memoria: el 0 es la raiz; las hojas y los niveles internos se
+    // agregan detras, de abajo hacia arriba
+    uint32_t leaves = (count + TREE_BUILD_FILL - 1) / TREE_BUILD_FILL;
+    uint32_t max_nodes = 1 + 2 * (leaves + 1);
+    struct tree_node *nodes = calloc(max_nodes, sizeof(struct tree_node));
+    struct dir_entry *level = malloc((leaves + 1) * sizeof(struct dir_entry));
+    if (nodes == NULL || level == NULL) {
+        fprintf(stderr, "Error: sin memoria para armar el arbol del directorio\n");
+        free(records);
+        free(nodes);
+        free(level);
+        return -1;
+    }
+
+    uint32_t used = 1;
+    if (leaves <= 1) {
+        // Entra todo en la raiz, que es una hoja
+        nodes[0].head.leaf = 1;
+        nodes[0].head.count = count;
+        memcpy(nodes[0].rec, records, count * sizeof(struct dir_entry));
+    } else {
+        // Hojas, encadenadas en orden; level queda con (nodo, menor clave) de cada una
+        uint32_t level_count = 0;
+        for (uint32_t k = 0; k < count; k += TREE_BUILD_FILL) {
+            uint32_t n = count - k < TREE_BUILD_FILL ? count - k : TREE_BUILD_FILL;
+            struct tree_node *leaf = &nodes[used];
+            leaf->head.leaf = 1;
+            leaf->head.count = n;
+            leaf->head.next = k + n < count ? used + 1 : 0;
+            memcpy(leaf->rec, &records[k], n * sizeof(struct dir_entry));
+            make_record(&level[level_count++], used++, records[k].name);
+        }
+
+        // Niveles internos hasta que los hijos entren en la raiz
+        while (level_count > TREE_RECORDS) {
+            uint32_t parents = 0;
+            for (uint32_t k = 0; k < level_count; k += TREE_BUILD_FILL) {
+                uint32_t n = level_count - k < TREE_BUILD_FILL ? level_count - k : TREE_BUILD_FILL;
+                struct tree_node *inner = &nodes[used];
+                inner->head.count = n;
+                memcpy(inner->rec, &level[k], n * sizeof(struct dir_entry));
+                make_record(&level[parents++], used++, level[k].name);
+            }
+            level_count = parents;
+        }
+
+        nodes[0].head.count = level_count;
+        memcpy(nodes[0].rec, level, level_count * sizeof(struct dir_entry));
+    }
+    free(records);
+    free(level);
+
+    // El menor nombre de cada nodo interno no se usa como clave
+    for (uint32_t n = 0; n < used; n++) {
+        if (!nodes[n].head.leaf)
+            memset(nodes[n].rec[0].name, 0, FILENAME_MAX_LEN);
+    }
+
+    if (hdr->tree_inode == 0) {
+        int tree_inode = create_empty_file_in_free_inode(image_path, 0600);
+        if (tree_inode < 0) {
+            fprintf(stderr, "No hay nodos-I libres para el arbol del directorio\n");
+            free(nodes);
+            return -1;
+        }
+        hdr->tree_inode = tree_inode;
+    } else {
+        // Arbol anterior: se vacia, para que sus nodos de mas no queden detras de los nuevos
+        // (node_append numera los nodos que agrega desde la cantidad de bloques del nodo-I)
+        struct inode in;
+        if (read_inode(image_path, hdr->tree_inode, &in) != 0 || inode_trunc_data(image_path, &in) != 0 ||
+            write_inode(image_path, hdr->tree_inode, &in) != 0) {
+            fprintf(stderr, "Error al vaciar el arbol anterior del directorio (nodo-I %u)\n", hdr->tree_inode);
+            free(nodes);
+            return -1;
+        }
+    }
+
+    size_t size = (size_t)used * BLOCK_SIZE;
+    result = inode_write_data(image_path, hdr->tree_inode, nodes, size, 0) == (int)size ? 0 : -1;
+    free(nodes);
+    if (result != 0) {
+        fprintf(stderr, "Error al escribir el arbol del directorio\n");
+        return -1;
+    }
+
+    DEBUG_PRINT("Arbol del directorio armado: %u entradas en %u nodos (nodo-I %u)\n", count, used,
+                hdr->tree_inode);
+    return 0;
+}
+
+void dir_tree_drop(const char *image_path, struct dir_header *hdr) {
+    // Descarta el arbol: libera su nodo-I y sus bloques y deja hdr sin arbol
+    if (hdr->tree_inode != 0) {
+        struct inode in;
+        if (read_inode(image_path, hdr->tree_inode, &in) != 0 || inode_trunc_data(image_path, &in) != 0 ||
+            free_inode(image_path, hdr->tree_inode) != 0)
+            fprintf(stderr, "Error al liberar el arbol del directorio (nodo-I %u)\n", hdr->tree_inode);
+    }
+
+    hdr->tree_inode = 0;
+}
+
+int dir_tree_iter_init(struct dir_tree_iter *it, const char *image_path, const struct dir_header *hdr,
+                       const char *start) {
+    // Prepara el recorrido en orden de las entradas con nombre >= start (NULL = todas)
+    // Baja una sola vez por el arbol. Retorna 0 o -1
+    struct tree t;
+    if (hdr->tree_inode == 0 || tree_open(&t, image_path, hdr->tree_inode) != 0)
+        return -1;
+
+    if (start == NULL)
+        start = "";
+
+    struct tree_node *node = (struct tree_node *)it->buf;
+    uint32_t node_nbr = 0;
+    if (node_read(&t, node_nbr, node) != 0)
+        return -1;
+    for (int depth = 0; !node->head.leaf; depth++) {
+        if (depth == TREE_MAX_DEPTH || node->head.count == 0) {
+            fprintf(stderr, "Error: el arbol del directorio esta dañado\n");
+            return -1;
+        }
+        node_nbr = node->rec[child_index(node, start)].inode;
+        if (node_read(&t, node_nbr, node) != 0)
+            return -1;
+    }
+
+    it->image_path = image_path;
+    it->tree = t.in;
+    it->tree_inode = hdr->tree_inode;
+    it->node = node_nbr;
+    it->pos = leaf_position(node, start);
+    return 0;
+}
+
+int dir_tree_iter_next(struct dir_tree_iter *it, struct dir_entry *entry) {
+    // Copia en entry la siguiente entrada en orden de nombre
+    // Retorna 1 si la copio, 0 si no hay mas, o -1 en caso de error
+    struct tree_node *node = (struct tree_node *)it->buf;
+
+    while (it->pos >= node->head.count) {
+        if (node->head.next == 0)
+            return 0;
+
+        struct tree t = {it->image_path, it->tree_inode, it->tree};
+        it->node = node->head.next;
+        it->pos = 0;
+        if (node_read(&t, it->node, node) != 0)
+            return -1;
+    }
+
+    *entry = node->rec[it->pos++];
+    return 1;
+}
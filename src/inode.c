@@ -4,12 +4,167 @@
 #include <fcntl.h>
 #include <stdint.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <time.h>
 #include <unistd.h>
 
 #include "vfs.h"
 
+// Cantidad de bloques de la tabla de nodos-I que se leen juntos al armar inode_map
+#define INODE_MAP_CHUNK_BLOCKS 64
+
+static uint8_t *load_inode_map(const char *image_path, const struct superblock *sb) {
+    // Retorna el mapa de nodos-I ocupados de la imagen (un bit por nodo-I, 1 = ocupado),
+    // armandolo la primera vez con una pasada por toda la tabla de nodos-I.
+    // Despues write_inode lo mantiene al dia. Retorna NULL en caso de error
+    struct vfs_dev *dev = vfs_open(image_path);
+    if (dev == NULL)
+        return NULL;
+    if (dev->inode_map != NULL)
+        return dev->inode_map;
+
+    // Los bits que sobran al final del ultimo byte quedan en 1, como si estuvieran ocupados
+    uint32_t map_bytes = (sb->inode_count + 7) / 8;
+    uint8_t *map = malloc(map_bytes);
+    if (map == NULL) {
+        fprintf(stderr, "Error: sin memoria para el mapa de nodos-I\n");
+        return NULL;
+    }
+    memset(map, 0xFF, map_bytes);
+
+    static uint8_t table[INODE_MAP_CHUNK_BLOCKS][BLOCK_SIZE];
+    uint32_t block_nums[INODE_MAP_CHUNK_BLOCKS];
+    void *buffers[INODE_MAP_CHUNK_BLOCKS];
+
+    for (uint32_t first = 0; first < sb->inode_blocks; first += INODE_MAP_CHUNK_BLOCKS) {
+        uint32_t n = sb->inode_blocks - first;
+        if (n > INODE_MAP_CHUNK_BLOCKS)
+            n = INODE_MAP_CHUNK_BLOCKS;
+        for (uint32_t k = 0; k < n; k++) {
+            block_nums[k] = sb->inode_start + first + k;
+            buffers[k] = table[k];
+        }
+
+        if (read_blocks(image_path, block_nums, buffers, n) != 0) {
+            fprintf(stderr, "Error al leer la tabla de nodos-I\n");
+            free(map);
+            return NULL;
+        }
+
+        for (uint32_t k = 0; k < n; k++) {
+            struct inode *inodes = (struct inode *)table[k];
+            for (uint32_t j = 0; j < INODES_PER_BLOCK; j++) {
+                uint32_t inode_nbr = (first + k) * INODES_PER_BLOCK + j;
+                if (inode_nbr > ROOTDIR_INODE && inode_nbr < sb->inode_count && inodes[j].mode == 0)
+                    map[inode_nbr / 8] &= ~(1 << (7 - inode_nbr % 8));
+            }
+        }
+    }
+
+    dev->inode_map = map;
+    return map;
+}
+
+static void update_inode_map(const char *image_path, uint32_t inode_number, const struct inode *in) {
+    // Refleja en inode_map (si ya se armo) si el nodo-I quedo ocupado o libre
+    struct vfs_dev *dev = vfs_open(image_path);
+    if (dev == NULL || dev->inode_map == NULL || inode_number <= ROOTDIR_INODE)
+        return;
+
+    uint8_t mask = 1 << (7 - inode_number % 8);
+    if (in->mode != 0)
+        dev->inode_map[inode_number / 8] |= mask;
+    else
+        dev->inode_map[inode_number / 8] &= ~mask;
+}
+
+static struct vfs_dev *lazy_dev(const char *image_path) {
+    // Retorna el dispositivo si tiene atimes pendientes (politica lazytime), o NULL
+    struct vfs_dev *dev = vfs_open(image_path);
+    if (dev == NULL || dev->lazy_count == 0)
+        return NULL;
+    return dev;
+}
+
+int inode_set_lazy_atime(const char *image_path, uint32_t inode_number, uint32_t atime) {
+    // Deja en memoria el atime del nodo-I, para escribirlo recien en vfs_sync/vfs_close.
+    // Mientras tanto read_inode y read_inodes ya lo devuelven actualizado
+    // Retorna 0 o -1 si encuentra un error
+    struct superblock sb_struct, *sb = &sb_struct;
+
+    if (read_superblock(image_path, sb) != 0) {
+        fprintf(stderr, "Error al leer superblock\n");
+        return -1;
+    }
+
+    if (inode_number < ROOTDIR_INODE || inode_number >= sb->inode_count) {
+        fprintf(stderr, "Error en inode_set_lazy_atime: nro nodo-I inválido (%d)\n", inode_number);
+        return -1;
+    }
+
+    struct vfs_dev *dev = vfs_open(image_path);
+    if (dev == NULL)
+        return -1;
+
+    if (dev->lazy_atime == NULL) {
+        dev->lazy_atime = calloc(sb->inode_count, sizeof(uint32_t));
+        if (dev->lazy_atime == NULL) {
+            fprintf(stderr, "Error: sin memoria para los atime pendientes\n");
+            return -1;
+        }
+    }
+
+    if (dev->lazy_atime[inode_number] == 0)
+        dev->lazy_count++;
+    dev->lazy_atime[inode_number] = atime;
+    return 0;
+}
+
+int inode_flush_lazy_atimes(struct vfs_dev *dev) {
+    // Escribe en la tabla de nodos-I los atime pendientes, leyendo y escribiendo
+    // una sola vez cada bloque de la tabla que tenga alguno. Lo usa vfs_sync
+    // Retorna 0 o -1 si encuentra un error
+    if (dev->lazy_count == 0)
+        return 0;
+
+    // Si hay atimes pendientes el superbloque ya esta en memoria
+    const struct superblock *sb = &dev->sb;
+    uint8_t buffer[BLOCK_SIZE];
+
+    for (uint32_t first = 0; first < sb->inode_count; first += INODES_PER_BLOCK) {
+        uint32_t last = first + INODES_PER_BLOCK;
+        if (last > sb->inode_count)
+            last = sb->inode_count;
+
+        uint32_t n = first;
+        while (n < last && dev->lazy_atime[n] == 0)
+            n++;
+        if (n == last)
+            continue;
+
+        uint32_t block_num = sb->inode_start + first / INODES_PER_BLOCK;
+        if (dev_read_block(dev, block_num, buffer) != 0)
+            return -1;
+
+        struct inode *inodes = (struct inode *)buffer;
+        for (; n < last; n++) {
+            if (dev->lazy_atime[n] == 0)
+                continue;
+            // Un nodo-I liberado mientras tanto queda como esta
+            if (inodes[n - first].mode != 0)
+                inodes[n - first].atime = dev->lazy_atime[n];
+            dev->lazy_atime[n] = 0;
+            dev->lazy_count--;
+        }
+
+        if (dev_write_block(dev, block_num, buffer) != 0)
+            return -1;
+    }
+
+    return 0;
+}
+
 int read_inode(const char *image_path, uint32_t inode_number, struct inode *in) {
     // Lee nodo-I de la posicion inode_number
     // lo retorna en la estructura apuntada por *in
@@ -40,9 +195,108 @@ int read_inode(const char *image_path, uint32_t inode_number, struct inode *in)
     struct inode *inodes = (struct inode *)inode_block_buffer;
     *in = inodes[block_offset];
 
+    // atime pendiente de escribir (lazytime)
+    struct vfs_dev *dev = lazy_dev(image_path);
+    if (dev != NULL && dev->lazy_atime[inode_number] != 0)
+        in->atime = dev->lazy_atime[inode_number];
+
     return 0;
 }
 
+static const uint32_t *sort_inode_base; // Numeros de nodo-I que ordena compare_by_inode
+
+static int compare_by_inode(const void *a, const void *b) {
+    uint32_t x = sort_inode_base[*(const uint32_t *)a], y = sort_inode_base[*(const uint32_t *)b];
+    return (x > y) - (x < y);
+}
+
+int read_inodes(const char *image_path, const uint32_t *inode_numbers, struct inode *inodes, uint32_t count) {
+    // Lee count nodos-I: inodes[k] queda con el nodo-I inode_numbers[k].
+    // Los bloques de la tabla de nodos-I se recorren en orden y cada uno se lee una sola vez,
+    // todos con una invocacion a read_blocks, aunque varios nodos-I compartan bloque.
+    // Los numeros de nodo-I invalidos se informan y se saltean: su lugar en inodes queda
+    // en cero (mode 0), asi el llamador puede omitir solo esa entrada.
+    // Retorna 0 o -1 si encuentra un error al leer
+    if (count == 0)
+        return 0;
+
+    struct superblock sb_struct, *sb = &sb_struct;
+
+    if (read_superblock(image_path, sb) != 0) {
+        fprintf(stderr, "Error al leer superblock\n");
+        return -1;
+    }
+
+    uint32_t *order = malloc(count * sizeof(uint32_t));
+    uint32_t *block_nums = malloc(count * sizeof(uint32_t));
+    void **buffers = malloc(count * sizeof(void *));
+    if (order == NULL || block_nums == NULL || buffers == NULL) {
+        fprintf(stderr, "Error: sin memoria para leer %u nodos-I\n", count);
+        free(order);
+        free(block_nums);
+        free(buffers);
+        return -1;
+    }
+
+    // Ordenar los pedidos validos por numero de nodo-I, asi quedan agrupados por bloque
+    uint32_t valid = 0;
+    for (uint32_t k = 0; k < count; k++) {
+        if (inode_numbers[k] < ROOTDIR_INODE || inode_numbers[k] >= sb->inode_count) {
+            fprintf(stderr, "Error en read_inodes: nro nodo-I inválido (%u)\n", inode_numbers[k]);
+            memset(&inodes[k], 0, sizeof(struct inode));
+            continue;
+        }
+        order[valid++] = k;
+    }
+    sort_inode_base = inode_numbers;
+    qsort(order, valid, sizeof(uint32_t), compare_by_inode);
+
+    // Los bloques distintos de la tabla, cada uno con su buffer
+    uint32_t nblocks = 0;
+    for (uint32_t k = 0; k < valid; k++) {
+        uint32_t block_num = sb->inode_start + inode_numbers[order[k]] / INODES_PER_BLOCK;
+        if (nblocks == 0 || block_nums[nblocks - 1] != block_num)
+            block_nums[nblocks++] = block_num;
+    }
+
+    uint8_t *table = malloc((size_t)nblocks * BLOCK_SIZE);
+    if (nblocks > 0 && table == NULL) {
+        fprintf(stderr, "Error: sin memoria para leer %u bloques de nodos-I\n", nblocks);
+        free(order);
+        free(block_nums);
+        free(buffers);
+        return -1;
+    }
+    for (uint32_t b = 0; b < nblocks; b++)
+        buffers[b] = table + (size_t)b * BLOCK_SIZE;
+
+    int result = read_blocks(image_path, block_nums, buffers, nblocks);
+    if (result != 0)
+        fprintf(stderr, "Error al leer la tabla de nodos-I\n");
+    else {
+        uint32_t b = 0;
+        for (uint32_t k = 0; k < valid; k++) {
+            uint32_t inode_nbr = inode_numbers[order[k]];
+            while (block_nums[b] != sb->inode_start + inode_nbr / INODES_PER_BLOCK)
+                b++;
+            const struct inode *block_inodes = (const struct inode *)buffers[b];
+            inodes[order[k]] = block_inodes[inode_nbr % INODES_PER_BLOCK];
+        }
+
+        struct vfs_dev *dev = lazy_dev(image_path);
+        for (uint32_t k = 0; dev != NULL && k < valid; k++) {
+            if (dev->lazy_atime[inode_numbers[order[k]]] != 0)
+                inodes[order[k]].atime = dev->lazy_atime[inode_numbers[order[k]]];
+        }
+    }
+
+    free(order);
+    free(block_nums);
+    free(buffers);
+    free(table);
+    return result;
+}
+
 int write_inode(const char *image_path, uint32_t inode_number, const struct inode *in) {
     struct superblock sb_struct, *sb = &sb_struct;
     // Escribe nodo-I de la posicion inode_number
@@ -76,6 +330,15 @@ int write_inode(const char *image_path, uint32_t inode_number, const struct inod
     if (write_block(image_path, sb->inode_start + block_index, inode_block_buffer) != 0)
         return -1;
 
+    update_inode_map(image_path, inode_number, in);
+
+    // El nodo-I escrito ya trae su atime, deja de estar pendiente
+    struct vfs_dev *dev = lazy_dev(image_path);
+    if (dev != NULL && dev->lazy_atime[inode_number] != 0) {
+        dev->lazy_atime[inode_number] = 0;
+        dev->lazy_count--;
+    }
+
     DEBUG_PRINT("Inodo %u escrito correctamente en bloque %u, offset %u\n", inode_number, sb->inode_start + block_index,
                 block_offset);
 
@@ -118,6 +381,8 @@ int free_inode(const char *image_path, uint32_t inode_number) {
     }
 
     sb->free_inodes++;
+    if (sb->next_free_inode == 0 || inode_number < sb->next_free_inode)
+        sb->next_free_inode = inode_number;
 
     if (write_superblock(image_path, sb) != 0) {
         fprintf(stderr, "Error al actualizar superbloque\n");
@@ -128,10 +393,372 @@ int free_inode(const char *image_path, uint32_t inode_number) {
     return 0;
 }
 
-int get_block_number_at(const char *image_path, struct inode *in, uint16_t index) {
+/*
+    Mapa de bloques del archivo: los primeros NUM_DIRECT_PTRS estan en direct[], los
+    NUM_INDIRECT_PTRS siguientes en el bloque indirecto, despues NUM_DINDIRECT_PTRS a
+    traves del doble indirecto (un bloque de punteros a bloques indirectos) y por ultimo
+    el triple indirecto. Un bloque de punteros de nivel l cubre NUM_INDIRECT_PTRS^l bloques.
+
+    El ultimo bloque de punteros leido de cada nivel queda en el dispositivo (ind_cache),
+    asi recorrer un archivo en orden lee cada bloque de punteros una sola vez.
+*/
+
+static uint32_t *map_root(struct inode *in, uint32_t *index, int *levels) {
+    // Retorna el puntero del nodo-I desde el que se llega al bloque index del archivo y
+    // cuantos niveles de bloques de punteros hay debajo. Deja en index la posicion
+    // relativa a ese puntero. Retorna NULL si index supera el mapa
+    if (*index < NUM_DIRECT_PTRS) {
+        *levels = 0;
+        return &in->direct[*index];
+    }
+    *index -= NUM_DIRECT_PTRS;
+
+    if (*index < NUM_INDIRECT_PTRS) {
+        *levels = 1;
+        return &in->indirect;
+    }
+    *index -= NUM_INDIRECT_PTRS;
+
+    if (*index < NUM_DINDIRECT_PTRS) {
+        *levels = 2;
+        return &in->dindirect;
+    }
+    *index -= NUM_DINDIRECT_PTRS;
+
+    if (*index < NUM_TINDIRECT_PTRS) {
+        *levels = 3;
+        return &in->tindirect;
+    }
+    return NULL;
+}
+
+static uint32_t level_slot(uint32_t index, int level) {
+    // Posicion dentro de un bloque de punteros de nivel level del bloque relativo index
+    uint32_t span = 1;
+    for (int l = 1; l < level; l++)
+        span *= NUM_INDIRECT_PTRS;
+    return index / span % NUM_INDIRECT_PTRS;
+}
+
+static const uint32_t *load_table(const char *image_path, int level, uint32_t block_num) {
+    // Retorna el contenido del bloque de punteros block_num de nivel level, desde ind_cache
+    // si es el ultimo leido de ese nivel. Retorna NULL en caso de error
+    struct vfs_dev *dev = vfs_open(image_path);
+    if (dev == NULL)
+        return NULL;
+
+    struct indirect_cache *cache = &dev->ind_cache[level - 1];
+    if (cache->block != block_num) {
+        if (read_block(image_path, block_num, cache->ptrs) != 0) {
+            cache->block = 0;
+            return NULL;
+        }
+        cache->block = block_num;
+    }
+    return cache->ptrs;
+}
+
+static int store_table(const char *image_path, int level, uint32_t block_num, const uint32_t *ptrs) {
+    // Escribe el bloque de punteros block_num de nivel level y lo deja en ind_cache
+    if (write_block(image_path, block_num, ptrs) != 0)
+        return -1;
+
+    struct vfs_dev *dev = vfs_open(image_path);
+    if (dev != NULL) {
+        struct indirect_cache *cache = &dev->ind_cache[level - 1];
+        cache->block = block_num;
+        memcpy(cache->ptrs, ptrs, BLOCK_SIZE);
+    }
+    return 0;
+}
+
+static void forget_tables(const char *image_path) {
+    // Descarta los bloques de punteros guardados (por ejemplo, porque se liberaron)
+    struct vfs_dev *dev = vfs_open(image_path);
+    if (dev == NULL)
+        return;
+    for (int l = 0; l < INDIRECT_LEVELS; l++)
+        dev->ind_cache[l].block = 0;
+}
+
+// Lista de bloques que crece a medida que se agregan, ver inode_trunc_data y map_undo
+struct block_list {
+    uint32_t *blocks;
+    uint32_t count;
+    uint32_t capacity;
+};
+
+static int list_push(struct block_list *list, uint32_t block) {
+    if (list->count == list->capacity) {
+        uint32_t capacity = list->capacity ? list->capacity * 2 : NUM_INDIRECT_PTRS;
+        uint32_t *blocks = realloc(list->blocks, capacity * sizeof(uint32_t));
+        if (blocks == NULL) {
+            fprintf(stderr, "Error: sin memoria para la lista de bloques a liberar\n");
+            return -1;
+        }
+        list->blocks = blocks;
+        list->capacity = capacity;
+    }
+    list->blocks[list->count++] = block;
+    return 0;
+}
+
+// Cambios en curso de un inode_append_blocks, para deshacerlos si falla: los bloques de
+// mapa que el nodo-I en disco ya referencia se copian antes de modificarlos, y los que se
+// reservan durante la llamada se anotan para liberarlos
+#define MAP_UNDO_SAVED (INDIRECT_LEVELS + 1)
+
+struct map_undo {
+    uint32_t saved_count;                                // Bloques guardados en saved
+    uint32_t saved_nums[MAP_UNDO_SAVED];                 // Numero de cada bloque guardado
+    uint32_t saved[MAP_UNDO_SAVED][NUM_INDIRECT_PTRS];   // Contenido original de cada uno
+    struct block_list created;                           // Bloques de mapa reservados
+    uint32_t spare;   // Bloque de extents que se reusa como bloque de punteros, 0 si ninguno
+};
+
+static int undo_save(const char *image_path, struct map_undo *undo, uint32_t block_num) {
+    // Guarda el contenido del bloque de mapa block_num antes de modificarlo, salvo que ya
+    // este guardado o se haya reservado en esta llamada. Al agregar al final del archivo se
+    // modifica a lo sumo un bloque ya existente por nivel. Retorna 0 o -1
+    for (uint32_t k = 0; k < undo->saved_count; k++) {
+        if (undo->saved_nums[k] == block_num)
+            return 0;
+    }
+    for (uint32_t k = 0; k < undo->created.count; k++) {
+        if (undo->created.blocks[k] == block_num)
+            return 0;
+    }
+
+    if (undo->saved_count == MAP_UNDO_SAVED) {
+        fprintf(stderr, "Error: demasiados bloques de mapa modificados a la vez\n");
+        return -1;
+    }
+    if (read_block(image_path, block_num, undo->saved[undo->saved_count]) != 0) {
+        fprintf(stderr, "Error al leer el bloque de mapa nro. %u\n", block_num);
+        return -1;
+    }
+    undo->saved_nums[undo->saved_count++] = block_num;
+    return 0;
+}
+
+static void undo_rollback(const char *image_path, struct map_undo *undo) {
+    // Vuelve los bloques de mapa al estado anterior a la llamada: reescribe los guardados
+    // y libera (con ceros) los reservados
+    forget_tables(image_path);
+    for (uint32_t k = 0; k < undo->saved_count; k++) {
+        if (write_block(image_path, undo->saved_nums[k], undo->saved[k]) != 0)
+            fprintf(stderr, "Error al restaurar el bloque de mapa nro. %u\n", undo->saved_nums[k]);
+    }
+    if (undo->created.count > 0 &&
+        bitmap_free_blocks(image_path, undo->created.blocks, undo->created.count, 1) != 0)
+        fprintf(stderr, "Error al liberar %u bloques de mapa\n", undo->created.count);
+}
+
+/*
+    Mapa por extents (INODE_FLAG_EXTENTS): los INLINE_EXTENTS primeros extents ocupan
+    direct[] e indirect (dos palabras cada uno) y los siguientes van en el bloque dindirect.
+    Un archivo escrito con bitmap_alloc_run queda en uno o dos extents, asi que ubicar
+    un bloque no requiere leer bloques de punteros.
+*/
+
+static uint32_t *inline_word(struct inode *in, uint32_t word) {
+    // Palabra word (0 a 2 * INLINE_EXTENTS - 1) del area de punteros del nodo-I
+    return word < NUM_DIRECT_PTRS ? &in->direct[word] : &in->indirect;
+}
+
+static struct extent get_inline_extent(struct inode *in, uint32_t k) {
+    struct extent ext = {*inline_word(in, 2 * k), *inline_word(in, 2 * k + 1)};
+    return ext;
+}
+
+static void set_inline_extent(struct inode *in, uint32_t k, struct extent ext) {
+    *inline_word(in, 2 * k) = ext.start;
+    *inline_word(in, 2 * k + 1) = ext.len;
+}
+
+static int read_extents(const char *image_path, struct inode *in, struct extent *list, uint32_t *count) {
+    // Copia en list (de INLINE_EXTENTS + EXTENTS_PER_BLOCK lugares) todos los extents
+    // del nodo-I y en count su cantidad. Retorna 0 o -1 en caso de error
+    *count = 0;
+    for (uint32_t k = 0; k < INLINE_EXTENTS; k++) {
+        struct extent ext = get_inline_extent(in, k);
+        if (ext.len == 0)
+            return 0;
+        list[(*count)++] = ext;
+    }
+
+    if (in->dindirect == 0)
+        return 0;
+
+    const uint32_t *ptrs = load_table(image_path, 1, in->dindirect);
+    if (ptrs == NULL) {
+        fprintf(stderr, "Error al leer el bloque de extents %u\n", in->dindirect);
+        return -1;
+    }
+
+    const struct extent *overflow = (const struct extent *)ptrs;
+    for (uint32_t k = 0; k < EXTENTS_PER_BLOCK && overflow[k].len != 0; k++)
+        list[(*count)++] = overflow[k];
+    return 0;
+}
+
+static int extent_block_at(const char *image_path, struct inode *in, uint32_t index) {
+    // Retorna el bloque de la posicion index de un nodo-I con extents, o -1 en caso de error
+    for (uint32_t k = 0; k < INLINE_EXTENTS; k++) {
+        struct extent ext = get_inline_extent(in, k);
+        if (ext.len == 0)
+            break;
+        if (index < ext.len)
+            return ext.start + index;
+        index -= ext.len;
+    }
+
+    if (in->dindirect != 0) {
+        const uint32_t *ptrs = load_table(image_path, 1, in->dindirect);
+        if (ptrs == NULL) {
+            fprintf(stderr, "Error al leer el bloque de extents %u\n", in->dindirect);
+            return -1;
+        }
+
+        const struct extent *overflow = (const struct extent *)ptrs;
+        for (uint32_t k = 0; k < EXTENTS_PER_BLOCK && overflow[k].len != 0; k++) {
+            if (index < overflow[k].len)
+                return overflow[k].start + index;
+            index -= overflow[k].len;
+        }
+    }
+
+    fprintf(stderr, "Error: los extents del archivo no cubren todos sus bloques\n");
+    return -1;
+}
+
+static int pointer_append_blocks(const char *image_path, struct inode *in, const uint32_t *blocks, uint32_t count,
+                                 struct map_undo *undo);
+
+static int extents_to_pointers(const char *image_path, struct inode *in, struct map_undo *undo) {
+    // Pasa un nodo-I con extents al mapa de punteros directos e indirectos,
+    // cuando el archivo quedo demasiado fragmentado para sus extents
+    // El bloque de extents no se libera: se reusa como el primer bloque de punteros (el
+    // archivo tiene mas bloques que punteros directos, asi que siempre hace falta uno).
+    // Hasta que el llamador escribe el nodo-I, el de la imagen sigue apuntandolo como
+    // bloque de extents; si algo falla, undo le devuelve su contenido original
+    // Retorna 0 o -1 en caso de error
+    struct extent list[INLINE_EXTENTS + EXTENTS_PER_BLOCK];
+    uint32_t count;
+    if (read_extents(image_path, in, list, &count) != 0)
+        return -1;
+
+    DEBUG_PRINT("Pasando %u extents a punteros de bloque\n", count);
+    if (in->dindirect != 0) {
+        if (undo_save(image_path, undo, in->dindirect) != 0)
+            return -1;
+        undo->spare = in->dindirect;
+    }
+
+    in->mode &= ~INODE_FLAG_EXTENTS;
+    memset(in->direct, 0, sizeof(in->direct));
+    in->indirect = in->dindirect = in->tindirect = 0;
+    in->blocks = 0;
+    forget_tables(image_path);
+
+    for (uint32_t k = 0; k < count; k++) {
+        uint32_t blocks[NUM_INDIRECT_PTRS];
+        for (uint32_t done = 0; done < list[k].len;) {
+            uint32_t n = 0;
+            while (n < NUM_INDIRECT_PTRS && done < list[k].len)
+                blocks[n++] = list[k].start + done++;
+            if (pointer_append_blocks(image_path, in, blocks, n, undo) != 0)
+                return -1;
+        }
+    }
+    return 0;
+}
+
+static int extent_append_run(const char *image_path, struct inode *in, uint32_t start, uint32_t len,
+                             struct map_undo *undo) {
+    // Agrega len bloques contiguos desde start al final de un nodo-I con extents: si siguen
+    // al ultimo extent solo se lo alarga, si no se agrega un extent nuevo. El bloque de
+    // extents que reserva o modifica queda anotado en undo
+    // Retorna 0, -1 en caso de error, o 1 si no entran mas extents (no se modifico nada)
+    uint32_t inline_count = 0;
+    while (inline_count < INLINE_EXTENTS && get_inline_extent(in, inline_count).len != 0)
+        inline_count++;
+
+    // Extents del bloque de extents, si el nodo-I tiene uno
+    uint32_t ptrs[NUM_INDIRECT_PTRS];
+    struct extent *overflow = (struct extent *)ptrs;
+    uint32_t overflow_count = 0;
+    if (in->dindirect != 0) {
+        if (undo_save(image_path, undo, in->dindirect) != 0)
+            return -1;
+        const uint32_t *cached = load_table(image_path, 1, in->dindirect);
+        if (cached == NULL) {
+            fprintf(stderr, "Error al leer el bloque de extents %u\n", in->dindirect);
+            return -1;
+        }
+        memcpy(ptrs, cached, BLOCK_SIZE);
+        while (overflow_count < EXTENTS_PER_BLOCK && overflow[overflow_count].len != 0)
+            overflow_count++;
+    }
+
+    if (overflow_count > 0) {
+        struct extent *last = &overflow[overflow_count - 1];
+        if (last->start + last->len == start) {
+            last->len += len;
+            if (store_table(image_path, 1, in->dindirect, ptrs) != 0)
+                return -1;
+            in->blocks += len;
+            return 0;
+        }
+    } else if (inline_count > 0) {
+        struct extent last = get_inline_extent(in, inline_count - 1);
+        if (last.start + last.len == start) {
+            last.len += len;
+            set_inline_extent(in, inline_count - 1, last);
+            in->blocks += len;
+            return 0;
+        }
+    }
+
+    struct extent ext = {start, len};
+
+    if (inline_count < INLINE_EXTENTS) {
+        set_inline_extent(in, inline_count, ext);
+        in->blocks += len;
+        return 0;
+    }
+
+    if (overflow_count == EXTENTS_PER_BLOCK)
+        return 1;
+
+    if (in->dindirect == 0) {
+        int new_table = bitmap_set_first_free(image_path);
+        if (new_table == -1) {
+            fprintf(stderr, "No hay bloques disponibles para el bloque de extents\n");
+            return -1;
+        }
+        if (list_push(&undo->created, new_table) != 0) {
+            bitmap_free_block(image_path, new_table);
+            return -1;
+        }
+        memset(ptrs, 0, BLOCK_SIZE);
+        in->dindirect = new_table;
+    }
+
+    overflow[overflow_count] = ext;
+    if (store_table(image_path, 1, in->dindirect, ptrs) != 0) {
+        fprintf(stderr, "Error escribiendo el bloque de extents nro. %u\n", in->dindirect);
+        return -1;
+    }
+
+    in->blocks += len;
+    return 0;
+}
+
+int get_block_number_at(const char *image_path, struct inode *in, uint32_t index) {
     // funcion prevista para ir "avanzando" bloque a bloque al procesar un archivo
     // retorna el nro de bloque de la posicion index (0, 1, ...) asociado al inode *in
-    // recorre primero los directos, luego los indirectos
+    // recorre primero los directos, luego el indirecto, el doble y el triple indirecto
     // retorna -1 si encuentra un error, o 0 si index esta fuera de rango
 
     if (index >= in->blocks) {
@@ -139,33 +766,85 @@ int get_block_number_at(const char *image_path, struct inode *in, uint16_t index
         return 0; // No es un error, tal vez fue mal invocada
     }
 
-    if (index < NUM_DIRECT_PTRS) {
-        // Acceso a puntero directo
-        return in->direct[index];
-    } else {
-        // Acceso al bloque indirecto
-        uint8_t buffer[BLOCK_SIZE];
-        if (in->indirect == 0) {
-            fprintf(stderr, "Error: bloque indirecto es 0, con index %d y in->blocks %u\n", index, in->blocks);
-            return -1;
-        }
+    if (in->mode & INODE_FLAG_EXTENTS)
+        return extent_block_at(image_path, in, index);
+
+    uint32_t relative = index;
+    int levels;
+    uint32_t *root = map_root(in, &relative, &levels);
+    if (root == NULL) {
+        fprintf(stderr, "Error inesperado. index %u supera el mapa de bloques\n", index);
+        return -1;
+    }
 
-        if (read_block(image_path, in->indirect, buffer) != 0) {
-            fprintf(stderr, "Error al leer el bloque indirecto %u: %s\n", in->indirect, strerror(errno));
+    // Bajar por los bloques de punteros hasta el bloque de datos
+    uint32_t block_num = *root;
+    for (int l = levels; l >= 1; l--) {
+        if (block_num == 0) {
+            fprintf(stderr, "Error: bloque de punteros de nivel %d es 0, con index %u y in->blocks %u\n", l, index,
+                    in->blocks);
             return -1;
         }
 
-        struct indirect_block *ind = (struct indirect_block *)buffer;
-        uint16_t indirect_index = index - NUM_DIRECT_PTRS;
-
-        if (indirect_index >= NUM_INDIRECT_PTRS) {
-            fprintf(stderr, "Error inesperado. indirect_index %d es mayor que %zu\n", indirect_index,
-                    NUM_INDIRECT_PTRS);
+        const uint32_t *ptrs = load_table(image_path, l, block_num);
+        if (ptrs == NULL) {
+            fprintf(stderr, "Error al leer el bloque de punteros %u: %s\n", block_num, strerror(errno));
             return -1;
         }
+        block_num = ptrs[level_slot(relative, l)];
+    }
 
-        return ind->blocks[indirect_index];
+    return block_num;
+}
+
+static uint32_t pointer_map_blocks(uint32_t nblocks) {
+    // Cantidad de bloques de punteros de un archivo de nblocks bloques con mapa de punteros
+    uint32_t pointer_blocks = 0;
+    uint32_t index = NUM_DIRECT_PTRS;
+    if (nblocks > index) {
+        pointer_blocks++; // Indirecto
+        index += NUM_INDIRECT_PTRS;
+    }
+    if (nblocks > index) {
+        uint32_t rest = nblocks - index;
+        if (rest > NUM_DINDIRECT_PTRS)
+            rest = NUM_DINDIRECT_PTRS;
+        pointer_blocks += 1 + (rest + NUM_INDIRECT_PTRS - 1) / NUM_INDIRECT_PTRS; // Doble indirecto
+        index += NUM_DINDIRECT_PTRS;
     }
+    if (nblocks > index) {
+        uint32_t rest = nblocks - index;
+        pointer_blocks += 1 + (rest + NUM_DINDIRECT_PTRS - 1) / NUM_DINDIRECT_PTRS +
+                          (rest + NUM_INDIRECT_PTRS - 1) / NUM_INDIRECT_PTRS; // Triple indirecto
+    }
+    return pointer_blocks;
+}
+
+uint32_t inode_map_blocks(uint32_t nblocks) {
+    // Retorna cuantos bloques de mapa (de extents o de punteros) puede necesitar, en el
+    // peor caso, un archivo nuevo de nblocks bloques de datos. Con extents alcanza con el
+    // bloque de extents; si el archivo se fragmenta tanto que pasa al mapa de punteros,
+    // ese bloque se reusa y hacen falta los bloques de punteros
+    uint32_t extent_blocks = nblocks > INLINE_EXTENTS ? 1 : 0;
+    if (nblocks <= INLINE_EXTENTS + EXTENTS_PER_BLOCK)
+        return extent_blocks;
+
+    uint32_t pointer_blocks = pointer_map_blocks(nblocks);
+    return pointer_blocks > extent_blocks ? pointer_blocks : extent_blocks;
+}
+
+uint32_t inode_extra_map_blocks(const struct inode *in, uint32_t nblocks) {
+    // Retorna cuantos bloques de mapa mas, en el peor caso, hay que reservar para que el
+    // archivo in llegue a nblocks bloques de datos
+    if (nblocks <= in->blocks)
+        return 0;
+
+    if (!(in->mode & INODE_FLAG_EXTENTS))
+        return pointer_map_blocks(nblocks) - pointer_map_blocks(in->blocks);
+
+    uint32_t needed = inode_map_blocks(nblocks);
+    uint32_t present = in->dindirect != 0 ? 1 : 0;
+    return needed > present ? needed - present : 0;
 }
 
 int create_empty_file_in_free_inode(const char *image_path, uint16_t perms) {
@@ -188,41 +867,48 @@ int create_empty_file_in_free_inode(const char *image_path, uint16_t perms) {
         return -1;
     }
 
-    // Buscar un inodo libre
-    for (uint32_t inode_nbr = ROOTDIR_INODE + 1; inode_nbr < sb->inode_count; inode_nbr++) {
-        struct inode tmp_inode;
+    // Buscar un inodo libre en el mapa de nodos-I, a partir de la pista del superbloque
+    // (antes de next_free_inode estan todos ocupados)
+    uint8_t *map = load_inode_map(image_path, sb);
+    if (map == NULL)
+        return -1;
 
-        if (read_inode(image_path, inode_nbr, &tmp_inode) != 0)
+    uint32_t hint = sb->next_free_inode > ROOTDIR_INODE ? sb->next_free_inode : ROOTDIR_INODE + 1;
+    uint32_t map_bytes = (sb->inode_count + 7) / 8;
+    int found = -1;
+    if (hint < sb->inode_count)
+        found = bitmap_find_first_zero(map + hint / 8, map_bytes - hint / 8);
+
+    if (found != -1) {
+        uint32_t inode_nbr = hint / 8 * 8 + found;
+        DEBUG_PRINT("Encontrado nodo-I libre nro %u.\n", inode_nbr);
+
+        // Inicializar y luego escribir el inodo con valores por defecto, excepto perms
+        struct inode in_struct = {0}, *in = &in_struct;
+        in->mode = INODE_MODE_FILE | INODE_FLAG_EXTENTS | perms;
+        in->uid = getuid();
+        in->gid = getgid();
+        in->blocks = 0;
+        in->size = 0;
+
+        time_t now = time(NULL);
+        in->atime = in->mtime = in->ctime = (uint32_t)now;
+
+        if (write_inode(image_path, inode_nbr, in) != 0) {
+            fprintf(stderr, "Error al escribir nodo-I nro %u.\n", inode_nbr);
             return -1;
-        if (tmp_inode.mode == 0) { // inodo libre
-            DEBUG_PRINT("Encontrado nodo-I libre nro %u.\n", inode_nbr);
-
-            // Inicializar y luego escribir el inodo con valores por defecto, excepto perms
-            struct inode in_struct = {0}, *in = &in_struct;
-            in->mode = INODE_MODE_FILE | perms;
-            in->uid = getuid();
-            in->gid = getgid();
-            in->blocks = 0;
-            in->size = 0;
-
-            time_t now = time(NULL);
-            in->atime = in->mtime = in->ctime = (uint32_t)now;
-
-            if (write_inode(image_path, inode_nbr, in) != 0) {
-                fprintf(stderr, "Error al escribir nodo-I nro %u.\n", inode_nbr);
-                return -1;
-            }
+        }
 
-            // Actualiza y reescribe superbloque
-            sb->free_inodes--;
+        // Actualiza y reescribe superbloque
+        sb->free_inodes--;
+        sb->next_free_inode = inode_nbr + 1;
 
-            if (write_superblock(image_path, sb) != 0) {
-                fprintf(stderr, "Error: no se pudo escribir el superbloque\n");
-                return -1;
-            }
-
-            return inode_nbr;
+        if (write_superblock(image_path, sb) != 0) {
+            fprintf(stderr, "Error: no se pudo escribir el superbloque\n");
+            return -1;
         }
+
+        return inode_nbr;
     }
 
     // si llegamos a este punto sin retornar, es que no hay mas nodos-I libres
@@ -230,76 +916,323 @@ int create_empty_file_in_free_inode(const char *image_path, uint16_t perms) {
     return -1;
 }
 
-int inode_append_block(const char *image_path, struct inode *in, uint32_t new_block_number) {
-    // Agrega bloque nro new_block_number al final de los bloques del archivo
-    // Retorna 0 si ejecuta bien, o -1 en caso de error
-    // Es responsabilidad del llamador
-    //      1. escribir a disco el nodo-I actualizado
-    //      2. que new_block_number sea un bloque valido sin usar, pero marcado ocupado en el bitmap
+int block_iter_init(struct block_iter *it, const char *image_path, struct inode *in, uint32_t first_index) {
+    // Prepara el recorrido en orden de los bloques del archivo *in desde first_index.
+    // El nodo-I no debe cambiar mientras se lo recorre
+    // Retorna 0 o -1 en caso de error
+    it->image_path = image_path;
+    it->in = in;
+    it->index = first_index;
+    it->table_first = 0;
+    it->table_count = 0;
+    it->extent_count = 0;
+
+    if (in->mode & INODE_FLAG_EXTENTS)
+        return read_extents(image_path, in, it->extents, &it->extent_count);
+    return 0;
+}
 
-    struct superblock sb_struct, *sb = &sb_struct;
+static int iter_block_at(struct block_iter *it, uint32_t index) {
+    // Bloque de la posicion index de un nodo-I con punteros. El bloque de punteros de
+    // nivel 1 que lo contiene queda copiado en el iterador y sirve para los siguientes
+    // Retorna el número de bloque, o -1 en caso de error
+    struct inode *in = it->in;
+    if (index < NUM_DIRECT_PTRS)
+        return in->direct[index];
 
-    // Leer el superbloque para validar argumentos
-    if (read_superblock(image_path, sb) != 0) {
-        fprintf(stderr, "Error al leer superblock\n");
+    if (it->table_count > 0 && index >= it->table_first && index - it->table_first < it->table_count)
+        return it->table[index - it->table_first];
+
+    uint32_t relative = index;
+    int levels;
+    uint32_t *root = map_root(in, &relative, &levels);
+    if (root == NULL) {
+        fprintf(stderr, "Error inesperado. index %u supera el mapa de bloques\n", index);
         return -1;
     }
 
-    if (new_block_number < sb->data_start || new_block_number >= sb->total_blocks) {
-        fprintf(stderr, "Bloque %u fuera de rango para agregar a archivo.\n", new_block_number);
-        return -1;
+    // Bajar hasta el bloque de punteros de nivel 1
+    uint32_t block_num = *root;
+    for (int l = levels; l >= 1; l--) {
+        if (block_num == 0) {
+            fprintf(stderr, "Error: bloque de punteros de nivel %d es 0, con index %u\n", l, index);
+            return -1;
+        }
+
+        const uint32_t *ptrs = load_table(it->image_path, l, block_num);
+        if (ptrs == NULL) {
+            fprintf(stderr, "Error al leer el bloque de punteros %u: %s\n", block_num, strerror(errno));
+            return -1;
+        }
+
+        if (l == 1) {
+            memcpy(it->table, ptrs, BLOCK_SIZE);
+            it->table_first = index - level_slot(relative, 1);
+            it->table_count = NUM_INDIRECT_PTRS;
+        } else
+            block_num = ptrs[level_slot(relative, l)];
     }
 
-    // Verificamos espacio en los punteros directos
-    for (int i = 0; i < NUM_DIRECT_PTRS; i++) {
-        if (in->direct[i] == 0) { // encontro un puntero directo libre
-            in->direct[i] = new_block_number;
-            in->blocks++;
-            return 0;
+    return it->table[index - it->table_first];
+}
+
+int block_iter_next(struct block_iter *it, uint32_t max_len, struct block_run *run) {
+    // Entrega en run el siguiente tramo de bloques del archivo que son contiguos en la
+    // imagen, de hasta max_len bloques (0 = sin límite), y avanza el iterador.
+    // Retorna 1 si entregó un tramo, 0 si no quedan bloques, o -1 en caso de error
+    struct inode *in = it->in;
+    if (it->index >= in->blocks)
+        return 0;
+
+    uint32_t limit = in->blocks - it->index;
+    if (max_len != 0 && max_len < limit)
+        limit = max_len;
+
+    if (in->mode & INODE_FLAG_EXTENTS) {
+        uint32_t offset = it->index;
+        for (uint32_t k = 0; k < it->extent_count; k++) {
+            if (offset < it->extents[k].len) {
+                run->start = it->extents[k].start + offset;
+                run->len = it->extents[k].len - offset < limit ? it->extents[k].len - offset : limit;
+                it->index += run->len;
+                return 1;
+            }
+            offset -= it->extents[k].len;
         }
+        fprintf(stderr, "Error: los extents del archivo no cubren todos sus bloques\n");
+        return -1;
     }
 
-    // Bloques directos ocupados, vamos a los indirectos
-    // Si ya esta usado el bloque indirecto, lo leemos; si no, lo inicializamos
-    uint32_t indirect_block[NUM_INDIRECT_PTRS] = {0}; // inicializado en 0
+    int first = iter_block_at(it, it->index);
+    if (first <= 0) {
+        if (first == 0)
+            fprintf(stderr, "Error: el bloque %u del archivo no está asignado\n", it->index);
+        return -1;
+    }
 
-    if (in->indirect == 0) {
-        // indirecto NO Existe: Asignamos nuevo bloque para punteros indirectos
-        int indirect_block_num = bitmap_set_first_free(image_path);
-        if (indirect_block_num == -1) {
-            fprintf(stderr, "No hay bloques disponibles para el bloque indirecto\n");
-            return -1;
+    uint32_t len = 1;
+    while (len < limit) {
+        int next = iter_block_at(it, it->index + len);
+        if (next != first + (int)len)
+            break;
+        len++;
+    }
+
+    run->start = first;
+    run->len = len;
+    it->index += len;
+    return 1;
+}
+
+static int pointer_append_blocks(const char *image_path, struct inode *in, const uint32_t *blocks, uint32_t count,
+                                 struct map_undo *undo) {
+    // Agrega count bloques al mapa de punteros del nodo-I, desde la posicion in->blocks.
+    // Se mantiene en memoria un bloque de punteros por nivel y cada uno se escribe una sola
+    // vez, al pasar al siguiente de ese nivel o al terminar. Los bloques de punteros que
+    // reserva o modifica quedan anotados en undo. Retorna 0 o -1 (el llamador deshace undo)
+    uint32_t tables[INDIRECT_LEVELS][NUM_INDIRECT_PTRS];
+    uint32_t table_nums[INDIRECT_LEVELS] = {0};
+    int dirty[INDIRECT_LEVELS] = {0};
+    int result = 0;
+
+    for (uint32_t k = 0; k < count && result == 0; k++) {
+        uint32_t relative = in->blocks;
+        int levels;
+        uint32_t *slot = map_root(in, &relative, &levels);
+        if (slot == NULL) {
+            fprintf(stderr, "Error: El archivo ha alcanzado el límite de bloques\n");
+            result = -1;
+            break;
         }
 
-        in->indirect = indirect_block_num;
+        // Bajar por los bloques de punteros, creando los que falten (quedan en cero)
+        for (int l = levels; l >= 1 && result == 0; l--) {
+            uint32_t *table = tables[l - 1];
+            int created = 0;
+
+            if (*slot == 0) {
+                // No existe: se usa el bloque de extents que quedo libre (ver extents_to_pointers)
+                // o asignamos un nuevo bloque de punteros
+                int new_table = undo->spare;
+                undo->spare = 0;
+                if (new_table == 0) {
+                    new_table = bitmap_set_first_free(image_path);
+                    if (new_table == -1) {
+                        fprintf(stderr, "No hay bloques disponibles para el bloque de punteros de nivel %d\n", l);
+                        result = -1;
+                        break;
+                    }
+                    if (list_push(&undo->created, new_table) != 0) {
+                        bitmap_free_block(image_path, new_table);
+                        result = -1;
+                        break;
+                    }
+                }
+                *slot = new_table;
+                created = 1;
 
-    } else {
-        // EXISTE: Leemos el bloque indirecto existente
-        if (read_block(image_path, in->indirect, indirect_block) != 0) {
-            fprintf(stderr, "Error leyendo el bloque indirecto nro. %u\n", in->indirect);
-            return -1;
+                // El puntero nuevo esta en el bloque de punteros del nivel de arriba
+                if (l < levels)
+                    dirty[l] = 1;
+            }
+
+            if (table_nums[l - 1] != *slot) {
+                // Cambia el bloque de punteros de este nivel: bajar a disco el anterior
+                if (dirty[l - 1] && store_table(image_path, l, table_nums[l - 1], table) != 0) {
+                    fprintf(stderr, "Error escribiendo el bloque de punteros nro. %u\n", table_nums[l - 1]);
+                    result = -1;
+                    break;
+                }
+
+                if (created)
+                    memset(table, 0, BLOCK_SIZE);
+                else {
+                    if (undo_save(image_path, undo, *slot) != 0) {
+                        result = -1;
+                        break;
+                    }
+                    const uint32_t *ptrs = load_table(image_path, l, *slot);
+                    if (ptrs == NULL) {
+                        fprintf(stderr, "Error leyendo el bloque de punteros nro. %u\n", *slot);
+                        result = -1;
+                        break;
+                    }
+                    memcpy(table, ptrs, BLOCK_SIZE);
+                }
+                table_nums[l - 1] = *slot;
+                dirty[l - 1] = created;
+            }
+
+            slot = &table[level_slot(relative, l)];
+        }
+
+        if (result != 0)
+            break;
+
+        *slot = blocks[k];
+        if (levels > 0)
+            dirty[0] = 1;
+        in->blocks++;
+    }
+
+    // Si fallo, no se escribe nada mas: el llamador restaura los bloques de punteros
+    if (result != 0)
+        return result;
+
+    // Escribir a "disco" los bloques de punteros que quedaron modificados
+    for (int l = 1; l <= INDIRECT_LEVELS; l++) {
+        if (dirty[l - 1] && store_table(image_path, l, table_nums[l - 1], tables[l - 1]) != 0) {
+            fprintf(stderr, "Error escribiendo el bloque de punteros nro. %u\n", table_nums[l - 1]);
+            result = -1;
         }
     }
 
-    // Buscar una posición libre en el bloque indirecto
-    for (uint32_t i = 0; i < NUM_INDIRECT_PTRS; i++) {
-        if (indirect_block[i] == 0) { // buscamos al primer bloque en 0
-            indirect_block[i] = new_block_number;
+    return result;
+}
 
-            // Escribir a "disco" el bloque indirecto actualizado
-            if (write_block(image_path, in->indirect, indirect_block) != 0) {
-                fprintf(stderr, "Error escribiendo el bloque indirecto nro. %u\n", in->indirect);
+static int append_to_map(const char *image_path, struct inode *in, const uint32_t *blocks, uint32_t count,
+                         struct map_undo *undo) {
+    // Agrega los bloques al mapa del nodo-I, anotando en undo lo que haga falta deshacer
+    // Retorna 0 o -1
+    uint32_t k = 0;
+    if (in->mode & INODE_FLAG_EXTENTS) {
+        // Agregar de a tramos contiguos
+        while (k < count) {
+            uint32_t len = 1;
+            while (k + len < count && blocks[k + len] == blocks[k] + len)
+                len++;
+
+            int result = extent_append_run(image_path, in, blocks[k], len, undo);
+            if (result < 0)
                 return -1;
+            if (result > 0) {
+                // No entran mas extents: el archivo pasa al mapa de punteros
+                if (extents_to_pointers(image_path, in, undo) != 0)
+                    return -1;
+                break;
             }
-
-            in->blocks++;
+            k += len;
+        }
+        if (k == count)
             return 0;
+    }
+
+    return pointer_append_blocks(image_path, in, blocks + k, count - k, undo);
+}
+
+int inode_append_blocks(const char *image_path, struct inode *in, const uint32_t *blocks, uint32_t count) {
+    // Agrega los count bloques de blocks, en orden, al final de los bloques del archivo
+    // Retorna 0 si ejecuta bien, o -1 en caso de error. Si falla, el nodo-I y sus bloques
+    // de mapa quedan como estaban y los bloques de mapa reservados se liberan
+    // Es responsabilidad del llamador
+    //      1. escribir a disco el nodo-I actualizado
+    //      2. que los bloques sean validos sin usar, pero marcados ocupados en el bitmap
+
+    struct superblock sb_struct, *sb = &sb_struct;
+
+    // Leer el superbloque para validar argumentos
+    if (read_superblock(image_path, sb) != 0) {
+        fprintf(stderr, "Error al leer superblock\n");
+        return -1;
+    }
+
+    for (uint32_t k = 0; k < count; k++) {
+        if (blocks[k] < sb->data_start || blocks[k] >= sb->total_blocks) {
+            fprintf(stderr, "Bloque %u fuera de rango para agregar a archivo.\n", blocks[k]);
+            return -1;
         }
     }
 
-    // No hay espacio ni en directos ni en indirectos
-    fprintf(stderr, "Error: El archivo ha alcanzado el límite de bloques\n");
-    return -1;
+    if ((uint32_t)in->blocks + count > MAX_FILE_BLOCKS) {
+        fprintf(stderr, "Error: El archivo ha alcanzado el límite de bloques\n");
+        return -1;
+    }
+
+    struct inode orig = *in;
+    struct map_undo undo;
+    undo.saved_count = 0;
+    undo.spare = 0;
+    memset(&undo.created, 0, sizeof(undo.created));
+
+    int result = append_to_map(image_path, in, blocks, count, &undo);
+    if (result != 0) {
+        undo_rollback(image_path, &undo);
+        *in = orig;
+    }
+
+    free(undo.created.blocks);
+    return result;
+}
+
+int inode_append_block(const char *image_path, struct inode *in, uint32_t new_block_number) {
+    // Agrega bloque nro new_block_number al final de los bloques del archivo
+    // Retorna 0 si ejecuta bien, o -1 en caso de error
+    // Mismas responsabilidades del llamador que inode_append_blocks
+    return inode_append_blocks(image_path, in, &new_block_number, 1);
+}
+
+static int collect_tree(const char *image_path, uint32_t block_num, int level, struct block_list *list) {
+    // Agrega a list el bloque de punteros block_num de nivel level y todo lo que cuelga de el
+    // Retorna 0 o -1 en caso de error
+    uint32_t ptrs[NUM_INDIRECT_PTRS];
+
+    DEBUG_PRINT("Leyendo bloque de punteros de nivel %d: %u\n", level, block_num);
+    if (read_block(image_path, block_num, ptrs) != 0) {
+        fprintf(stderr, "Error al leer bloque de punteros nro %u.\n", block_num);
+        return -1;
+    }
+
+    for (size_t j = 0; j < NUM_INDIRECT_PTRS; j++) {
+        if (ptrs[j] == 0)
+            continue;
+        if (level == 1) {
+            if (list_push(list, ptrs[j]) != 0)
+                return -1;
+        } else if (collect_tree(image_path, ptrs[j], level - 1, list) != 0)
+            return -1;
+    }
+
+    return list_push(list, block_num);
 }
 
 int inode_trunc_data(const char *image_path, struct inode *in) {
@@ -307,35 +1240,58 @@ int inode_trunc_data(const char *image_path, struct inode *in) {
     // marcandolos como libres en el bitmap y actualizando indirectamente el superblock
     // Retorna 0 si ejecuta bien, o -1 en caso de error
 
-    // Liberar bloques directos
+    // Juntar todos los bloques a liberar: directos, de datos y de punteros de cada nivel
+    struct block_list list = {0};
+    int result = 0;
+
+    if (in->mode & INODE_FLAG_EXTENTS) {
+        // Los bloques de cada extent y el bloque de extents
+        struct extent extents[INLINE_EXTENTS + EXTENTS_PER_BLOCK];
+        uint32_t count;
+        if (read_extents(image_path, in, extents, &count) != 0)
+            return -1;
+
+        for (uint32_t k = 0; k < count; k++) {
+            DEBUG_PRINT("Liberando extent #%u: %u bloques desde %u\n", k, extents[k].len, extents[k].start);
+            for (uint32_t b = 0; b < extents[k].len; b++)
+                result |= list_push(&list, extents[k].start + b);
+        }
+        if (in->dindirect != 0)
+            result |= list_push(&list, in->dindirect);
+
+        memset(in->direct, 0, sizeof(in->direct));
+        in->indirect = in->dindirect = in->tindirect = 0;
+    }
+
     for (int i = 0; i < NUM_DIRECT_PTRS; i++) {
         if (in->direct[i] != 0) {
             DEBUG_PRINT("Liberando bloque directo #%d: %u\n", i, in->direct[i]);
-            bitmap_free_block(image_path, in->direct[i]);
+            result |= list_push(&list, in->direct[i]);
             in->direct[i] = 0;
         }
     }
 
-    // Liberar bloques indirectos, a partir del bloque de punteros indirectos
-    if (in->indirect != 0) {
-        DEBUG_PRINT("Leyendo bloque indirecto: %u\n", in->indirect);
-
-        uint32_t indirect_block[NUM_INDIRECT_PTRS];
-        if (read_block(image_path, in->indirect, indirect_block) != 0) {
-            fprintf(stderr, "Error al leer bloque indirecto nro %u.\n", in->indirect);
-            return -1;
-        } else {
-            for (size_t j = 0; j < NUM_INDIRECT_PTRS; j++) {
-                if (indirect_block[j] != 0) {
-                    DEBUG_PRINT("Liberando bloque referenciado indirecto #%zu: %u\n", j, indirect_block[j]);
-                    bitmap_free_block(image_path, indirect_block[j]);
-                }
-            }
+    uint32_t *roots[INDIRECT_LEVELS] = {&in->indirect, &in->dindirect, &in->tindirect};
+    for (int l = 1; l <= INDIRECT_LEVELS; l++) {
+        if (*roots[l - 1] != 0) {
+            result |= collect_tree(image_path, *roots[l - 1], l, &list);
+            *roots[l - 1] = 0;
         }
+    }
 
-        DEBUG_PRINT("Liberando bloque de punteros indirectos: %u\n", in->indirect);
-        bitmap_free_block(image_path, in->indirect);
-        in->indirect = 0;
+    if (result != 0) {
+        free(list.blocks);
+        return -1;
+    }
+
+    // Escribir ceros en todos los bloques y marcarlos libres, actualizando
+    // cada bloque de bitmap y el superbloque una sola vez
+    forget_tables(image_path);
+    result = bitmap_free_blocks(image_path, list.blocks, list.count, 1);
+    free(list.blocks);
+    if (result != 0) {
+        fprintf(stderr, "Error al liberar los bloques del archivo.\n");
+        return -1;
     }
 
     DEBUG_PRINT("Archivo truncado: tamaño y bloques puestos en cero\n");
@@ -96,26 +96,82 @@ int name_is_valid(const char *name) {
     return 1;
 }
 
-int dir_lookup(const char *image_path, const char *filename) {
-    // No valida que el nombre sea válido ni que la imagen lo sea
-    // Retorna nodo-I encontrado para la entrada,
-    // retorna 0 (nodo-I invalido) si no lo encuentra, o -1 en caso de errores
+// Verifica que cada componente de la ruta (separados por '/', con una '/' opcional al
+// principio) sea un nombre valido, como los que acepta name_is_valid
+int path_is_valid(const char *path) {
+    if (!path)
+        return 0;
+    if (*path == '/')
+        path++;
 
-    struct inode root_inode;
+    char name[FILENAME_MAX_LEN];
+    do {
+        size_t len = strcspn(path, "/");
+        if (len >= FILENAME_MAX_LEN)
+            return 0;
+        memcpy(name, path, len);
+        name[len] = '\0';
+        if (!name_is_valid(name))
+            return 0;
+        path += len;
+    } while (*path++ == '/');
 
-    // Leer el nodo-I de la raiz, bien conocida
-    if (read_inode(image_path, ROOTDIR_INODE, &root_inode) != 0) {
-        return -1;
-    }
+    return 1;
+}
 
-    // recorre todos sus bloques de datos para buscar filename
-    for (uint16_t i = 0; i < root_inode.blocks; i++) {
+// Recorrido de los bloques de un directorio de a uno, sobre block_iter
+struct dir_walk {
+    struct block_iter it;
+    struct block_run run;
+    uint32_t index;  // Posicion en el directorio del proximo bloque
+};
+
+static int dir_walk_init(struct dir_walk *walk, const char *image_path, struct inode *dir, uint32_t first) {
+    // Prepara el recorrido desde el bloque nro first del directorio
+    walk->run.len = 0;
+    walk->index = first;
+    return block_iter_init(&walk->it, image_path, dir, first);
+}
 
-        int block_num = get_block_number_at(image_path, &root_inode, i);
-        if (block_num <= 0) {
-            fprintf(stderr, "Error inesperado el buscar bloque %d del directorio raiz.\n", i);
-            return -1;
+static int dir_walk_next(struct dir_walk *walk) {
+    // Retorna el siguiente bloque del directorio, 0 si no hay mas, o -1 en caso de error
+    if (walk->run.len == 0) {
+        int result = block_iter_next(&walk->it, 0, &walk->run);
+        if (result <= 0) {
+            if (result < 0)
+                fprintf(stderr, "Error inesperado al buscar bloque %u del directorio.\n", walk->it.index);
+            return result;
         }
+    }
+    walk->run.len--;
+    walk->index++;
+    return walk->run.start++;
+}
+
+static int find_entry(const char *image_path, uint32_t dir_nbr, struct inode *dir, const char *filename,
+                      uint32_t *loc) {
+    // Busca filename en el directorio dir_nbr, con su indice hash si lo tiene o recorriendo
+    // todos sus bloques si no. Antes pregunta a su filtro de Bloom, que casi siempre
+    // descarta los nombres que no estan sin leer nada mas
+    // Retorna el nodo-I de la entrada (y en *loc su posicion), 0 si no la encuentra,
+    // o -1 en caso de error
+    struct dir_header hdr;
+    int has_header = dir_header_read(image_path, dir_nbr, dir, &hdr);
+    if (has_header < 0)
+        return -1;
+    if (has_header) {
+        int maybe = dir_bloom_test(image_path, &hdr, filename);
+        if (maybe <= 0)
+            return maybe;
+    }
+    if (has_header && hdr.index_inode != 0)
+        return dir_hash_find(image_path, dir, &hdr, filename, loc);
+
+    struct dir_walk walk;
+    int block_num;
+    if (dir_walk_init(&walk, image_path, dir, 0) != 0)
+        return -1;
+    while ((block_num = dir_walk_next(&walk)) > 0) {
 
         uint8_t data_buf[BLOCK_SIZE];
         if (read_block(image_path, block_num, data_buf) != 0) {
@@ -129,106 +185,334 @@ int dir_lookup(const char *image_path, const char *filename) {
                 continue;
 
             if (strncmp(entries[j].name, filename, FILENAME_MAX_LEN) == 0) {
+                *loc = DIR_LOC(walk.index - 1, j);
                 return entries[j].inode;
             }
         }
     }
 
+    if (block_num < 0)
+        return -1;
+
     return 0; // No encontrado
 }
 
-int add_dir_entry(const char *image_path, const char *filename, uint32_t inode_number) {
-    // No valida el nro de inodo
+static void update_header(const char *image_path, uint32_t dir_nbr, struct inode *dir, const char *filename,
+                          uint32_t inode_number, uint32_t loc, int added) {
+    // Refleja en la cabecera del directorio (pista de entrada libre, indice hash, arbol de
+    // nombres y filtro de Bloom) la entrada loc agregada o borrada. Si no se puede actualizar
+    // alguno, se descarta: el directorio sigue siendo valido sin ellos
+    // Un directorio de un solo bloque se recorre con una lectura: el indice, el arbol y el
+    // filtro se arman recien cuando crece, y hasta entonces no ocupan nodos-I ni bloques
+    struct dir_header hdr;
+    if (dir_header_read(image_path, dir_nbr, dir, &hdr) != 1)
+        return;
+
+    // Al agregar se usa la primera entrada libre desde la pista, asi que hasta loc no queda
+    // ninguna; al borrar, loc queda libre
+    if (added && hdr.free_hint <= loc)
+        hdr.free_hint = loc + 1;
+    else if (!added && loc < hdr.free_hint)
+        hdr.free_hint = loc;
+
+    int grown = dir->blocks > 1;
+    int result = 0;
+
+    if (!added)
+        result = dir_hash_remove(image_path, &hdr, filename, loc);
+    else if (hdr.index_inode != 0 || grown)
+        result = dir_hash_insert(image_path, dir, &hdr, filename, loc);
+    if (result != 0) {
+        fprintf(stderr, "Aviso: no se pudo actualizar el indice del directorio, se descarta\n");
+        dir_hash_drop(image_path, &hdr);
+    }
 
-    if (!name_is_valid(filename)) {
-        DEBUG_PRINT("Nombre de archivo %s no es valido para agregarlo al directorio.\n", filename);
-        return -1;
+    result = 0;
+    if (!added)
+        result = dir_tree_remove(image_path, &hdr, filename);
+    else if (hdr.tree_inode != 0 || grown)
+        result = dir_tree_insert(image_path, dir, &hdr, filename, inode_number);
+    if (result != 0) {
+        fprintf(stderr, "Aviso: no se pudo actualizar el arbol del directorio, se descarta\n");
+        dir_tree_drop(image_path, &hdr);
     }
-    
-    struct inode root_inode;
 
-    if (read_inode(image_path, ROOTDIR_INODE, &root_inode) != 0)
-        return -1;
+    result = 0;
+    if (!added)
+        result = dir_bloom_remove(image_path, dir, &hdr);
+    else if (hdr.bloom_inode != 0 || grown)
+        result = dir_bloom_add(image_path, dir, &hdr, filename);
+    if (result != 0) {
+        fprintf(stderr, "Aviso: no se pudo actualizar el filtro del directorio, se descarta\n");
+        dir_bloom_drop(image_path, &hdr);
+    }
 
-    for (int i = 0; i < root_inode.blocks; i++) {
+    if (dir_header_write(image_path, dir, &hdr) != 0)
+        fprintf(stderr, "Error al escribir la cabecera del directorio (nodo-I %u)\n", dir_nbr);
+}
 
-        int block_num = get_block_number_at(image_path, &root_inode, i);
-        if (block_num <= 0) {
-            fprintf(stderr, "Error inesperado el buscar bloque %d del directorio raiz.\n", i);
-            return -1;
+int dir_lookup_in(const char *image_path, uint32_t dir_inode, const char *name, uint16_t *mode) {
+    // Busca name en el directorio dir_inode, primero en el cache de nombres
+    // Si mode no es NULL, deja ahi el modo del nodo-I encontrado (lo lee si el cache no lo tenia)
+    // Retorna el nodo-I, 0 si no existe, o -1 en caso de error
+    uint32_t inode_nbr;
+    uint16_t inode_mode;
+    if (dcache_lookup(image_path, dir_inode, name, &inode_nbr, &inode_mode)) {
+        if (inode_nbr == 0 || mode == NULL || inode_mode != 0) {
+            if (mode != NULL)
+                *mode = inode_mode;
+            return inode_nbr;
         }
+    } else {
+        struct inode dir;
+        uint32_t loc;
+        if (read_inode(image_path, dir_inode, &dir) != 0)
+            return -1;
+        int found = find_entry(image_path, dir_inode, &dir, name, &loc);
+        if (found < 0)
+            return -1;
+        inode_nbr = found;
+        inode_mode = 0;
+    }
 
-        uint8_t data_buf[BLOCK_SIZE];
-        if (read_block(image_path, block_num, data_buf) != 0)
+    if (inode_nbr != 0 && mode != NULL) {
+        struct inode in;
+        if (read_inode(image_path, inode_nbr, &in) != 0)
             return -1;
+        inode_mode = in.mode;
+        *mode = inode_mode;
+    }
 
-        struct dir_entry *entries = (struct dir_entry *)data_buf;
+    dcache_store(image_path, dir_inode, name, inode_nbr, inode_mode);
+    return inode_nbr;
+}
 
-        for (uint32_t j = 0; j < DIR_ENTRIES_PER_BLOCK; j++) {
-            if (entries[j].inode == 0) {
-                entries[j].inode = inode_number;
-                strncpy(entries[j].name, filename, FILENAME_MAX_LEN);
-                DEBUG_PRINT("Escribiendo entry %s %u en blocknum %d.\n", filename, inode_number, block_num);
+int dir_resolve(const char *image_path, const char *path, uint32_t *parent, char *name) {
+    // Recorre la ruta path (desde la raiz, con o sin '/' al principio) hasta su ultimo
+    // componente: deja en *parent el directorio que lo contiene y en name (FILENAME_MAX_LEN
+    // bytes) su nombre. Sin componentes ("" o "/") es la entrada "." de la raiz
+    // Los directorios intermedios se buscan con dir_lookup_in, asi que con el cache de
+    // nombres resolver rutas bajo el mismo directorio no lo vuelve a leer
+    // Retorna 1, 0 si un directorio intermedio no existe o no es un directorio (con errno en
+    // ENOENT o ENOTDIR), o -1 en caso de error
+    uint32_t dir_nbr = ROOTDIR_INODE;
+    int pending = 0;  // name tiene un componente que todavia no se busco
+    strcpy(name, ".");
+
+    while (*path != '\0') {
+        if (*path == '/') {
+            path++;
+            continue;
+        }
 
-                if (write_block(image_path, block_num, data_buf) != 0)
-                    return -1;
+        size_t len = strcspn(path, "/");
+        if (len >= FILENAME_MAX_LEN) {
+            errno = ENAMETOOLONG;
+            return 0;
+        }
 
-                return 0; // OK
+        // El componente anterior no era el ultimo: tiene que ser un directorio
+        if (pending) {
+            uint16_t mode;
+            int child = dir_lookup_in(image_path, dir_nbr, name, &mode);
+            if (child < 0)
+                return -1;
+            if (child == 0 || (mode & INODE_MODE_DIR) != INODE_MODE_DIR) {
+                errno = child == 0 ? ENOENT : ENOTDIR;
+                return 0;
             }
+            dir_nbr = child;
         }
+
+        memcpy(name, path, len);
+        name[len] = '\0';
+        pending = 1;
+        path += len;
     }
 
-    // No se encontró una entrada libre
-    errno = ENOSPC;
-    return -1;
+    *parent = dir_nbr;
+    return 1;
 }
 
-int remove_dir_entry(const char *image_path, const char *filename) {
-    // elimina logicamente una entrada de directorio, escribiendo ceros en ella
-    // busca la entrada por el nombre del filename
-    // Retorna 0 si se eliminó o no estaba, -1 en caso de error
+int dir_lookup(const char *image_path, const char *path) {
+    // No valida que el nombre sea válido ni que la imagen lo sea
+    // Retorna nodo-I encontrado para la ruta,
+    // retorna 0 (nodo-I invalido) si no lo encuentra, o -1 en caso de errores
+    uint32_t dir_nbr;
+    char name[FILENAME_MAX_LEN];
+    int resolved = dir_resolve(image_path, path, &dir_nbr, name);
+    if (resolved <= 0)
+        return resolved;
 
-    struct inode root_inode;
+    return dir_lookup_in(image_path, dir_nbr, name, NULL);
+}
 
-    if (read_inode(image_path, ROOTDIR_INODE, &root_inode) != 0) {
+static int grow_dir(const char *image_path, uint32_t dir_nbr, struct inode *dir, uint8_t *data_buf) {
+    // Agrega un bloque vacio al final del directorio y lo deja (en ceros) en data_buf
+    // Retorna el numero del bloque, o -1 en caso de error
+    int block_num = bitmap_set_first_free(image_path);
+    if (block_num == -1) {
+        fprintf(stderr, "No hay bloques disponibles para agrandar el directorio\n");
+        errno = ENOSPC;
         return -1;
     }
 
-    for (uint16_t i = 0; i < root_inode.blocks; i++) {
+    // Los bloques libres ya estan en cero, pero se escribe igual con la entrada nueva
+    memset(data_buf, 0, BLOCK_SIZE);
+    if (inode_append_block(image_path, dir, block_num) != 0) {
+        bitmap_free_block(image_path, block_num);
+        return -1;
+    }
 
-        int block_num = get_block_number_at(image_path, &root_inode, i);
-        if (block_num <= 0) {
-            fprintf(stderr, "Error inesperado el buscar bloque %d del directorio raiz.\n", i);
+    dir->size += BLOCK_SIZE;
+    dir->mtime = (uint32_t)time(NULL);
+    if (write_inode(image_path, dir_nbr, dir) != 0) {
+        fprintf(stderr, "Error al escribir el nodo-I del directorio\n");
+        return -1;
+    }
+
+    DEBUG_PRINT("Directorio %u agrandado a %u bloques con el bloque %d\n", dir_nbr, dir->blocks, block_num);
+    return block_num;
+}
+
+int add_dir_entry(const char *image_path, const char *path, uint32_t inode_number) {
+    // No valida el nro de inodo
+    // Agrega el ultimo componente de path al directorio que lo contiene
+    // Usa la primera entrada libre desde la pista de la cabecera; si el directorio
+    // esta lleno, lo agranda con un bloque nuevo
+
+    uint32_t dir_nbr;
+    char filename[FILENAME_MAX_LEN];
+    int resolved = dir_resolve(image_path, path, &dir_nbr, filename);
+    if (resolved <= 0) {
+        if (resolved == 0)
+            fprintf(stderr, "No existe el directorio de '%s': %s\n", path, strerror(errno));
+        return -1;
+    }
+
+    if (!name_is_valid(filename)) {
+        DEBUG_PRINT("Nombre de archivo %s no es valido para agregarlo al directorio.\n", filename);
+        return -1;
+    }
+    
+    struct inode dir;
+
+    if (read_inode(image_path, dir_nbr, &dir) != 0)
+        return -1;
+
+    // Antes de la pista no hay entradas libres (sin cabecera se busca desde el principio)
+    struct dir_header hdr;
+    int has_header = dir_header_read(image_path, dir_nbr, &dir, &hdr);
+    if (has_header < 0)
+        return -1;
+    uint32_t first = has_header ? hdr.free_hint : 0;
+    if (first > DIR_LOC(dir.blocks, 0))
+        first = DIR_LOC(dir.blocks, 0);
+
+    uint8_t data_buf[BLOCK_SIZE];
+    uint32_t block_index = first / DIR_ENTRIES_PER_BLOCK;
+    uint32_t slot = first % DIR_ENTRIES_PER_BLOCK;
+    struct dir_walk walk;
+    int block_num = 0;
+
+    if (block_index < dir.blocks) {
+        if (dir_walk_init(&walk, image_path, &dir, block_index) != 0)
             return -1;
+        while ((block_num = dir_walk_next(&walk)) > 0) {
+            if (read_block(image_path, block_num, data_buf) != 0)
+                return -1;
+
+            const struct dir_entry *entries = (const struct dir_entry *)data_buf;
+            while (slot < DIR_ENTRIES_PER_BLOCK && entries[slot].inode != 0)
+                slot++;
+            if (slot < DIR_ENTRIES_PER_BLOCK) {
+                block_index = walk.index - 1;
+                break;
+            }
+            slot = 0;
         }
+        if (block_num < 0)
+            return -1;
+    }
 
-        uint8_t data_buf[BLOCK_SIZE];
-        if (read_block(image_path, block_num, data_buf) != 0) {
-            fprintf(stderr, "Error al leer el bloque %d: %s\n", block_num, strerror(errno));
+    // No hay entradas libres: se agrega un bloque al directorio
+    if (block_num == 0) {
+        block_num = grow_dir(image_path, dir_nbr, &dir, data_buf);
+        if (block_num < 0)
             return -1;
-        }
+        block_index = dir.blocks - 1;
+        slot = 0;
+    }
 
-        struct dir_entry *entries = (struct dir_entry *)data_buf;
+    struct dir_entry *entries = (struct dir_entry *)data_buf;
+    entries[slot].inode = inode_number;
+    strncpy(entries[slot].name, filename, FILENAME_MAX_LEN);
+    DEBUG_PRINT("Escribiendo entry %s %u en blocknum %d.\n", filename, inode_number, block_num);
 
-        for (uint32_t j = 0; j < DIR_ENTRIES_PER_BLOCK; j++) {
-            if (entries[j].inode != 0 && strncmp(entries[j].name, filename, FILENAME_MAX_LEN) == 0) {
+    if (write_block(image_path, block_num, data_buf) != 0)
+        return -1;
 
-                DEBUG_PRINT("Eliminando entrada de directorio '%s' (inode %u) en bloque %d, pos %u\n", filename,
-                            entries[j].inode, block_num, j);
+    update_header(image_path, dir_nbr, &dir, filename, inode_number, DIR_LOC(block_index, slot), 1);
+    dcache_store(image_path, dir_nbr, filename, inode_number, 0);
+    return 0; // OK
+}
 
-                entries[j].inode = 0;
-                memset(entries[j].name, 0, FILENAME_MAX_LEN);
+int remove_dir_entry(const char *image_path, const char *path) {
+    // elimina logicamente una entrada de directorio, escribiendo ceros en ella
+    // busca la entrada por el ultimo componente de path, en el directorio que lo contiene
+    // Retorna 0 si se eliminó o no estaba, -1 en caso de error
 
-                if (write_block(image_path, block_num, data_buf) != 0) {
-                    fprintf(stderr, "Error al escribir bloque de directorio actualizado\n");
-                    return -1;
-                }
+    uint32_t dir_nbr;
+    char filename[FILENAME_MAX_LEN];
+    int resolved = dir_resolve(image_path, path, &dir_nbr, filename);
+    if (resolved <= 0) {
+        if (resolved == 0)
+            DEBUG_PRINT("No existe el directorio de '%s'\n", path);
+        return resolved; // Sin directorio tampoco esta la entrada, pero no es error
+    }
 
-                return 0;
-            }
-        }
+    // "." guarda la cabecera del directorio y ".." a su padre: no se borran
+    if (strcmp(filename, ".") == 0 || strcmp(filename, "..") == 0) {
+        fprintf(stderr, "No se puede eliminar la entrada '%s' del directorio\n", filename);
+        return -1;
+    }
+
+    struct inode dir;
+
+    if (read_inode(image_path, dir_nbr, &dir) != 0) {
+        return -1;
+    }
+
+    uint32_t loc;
+    int inode_nbr = find_entry(image_path, dir_nbr, &dir, filename, &loc);
+    if (inode_nbr < 0)
+        return -1;
+    if (inode_nbr == 0) {
+        DEBUG_PRINT("Archivo '%s' no estaba en el directorio\n", filename);
+        return 0; // No encontrado, pero no es error
+    }
+
+    int block_num = get_block_number_at(image_path, &dir, loc / DIR_ENTRIES_PER_BLOCK);
+    uint8_t data_buf[BLOCK_SIZE];
+    if (block_num <= 0 || read_block(image_path, block_num, data_buf) != 0) {
+        fprintf(stderr, "Error al leer el bloque %d: %s\n", block_num, strerror(errno));
+        return -1;
+    }
+
+    struct dir_entry *entry = (struct dir_entry *)data_buf + loc % DIR_ENTRIES_PER_BLOCK;
+
+    DEBUG_PRINT("Eliminando entrada de directorio '%s' (inode %u) en bloque %d, pos %u\n", filename, entry->inode,
+                block_num, loc % DIR_ENTRIES_PER_BLOCK);
+
+    entry->inode = 0;
+    memset(entry->name, 0, FILENAME_MAX_LEN);
+
+    if (write_block(image_path, block_num, data_buf) != 0) {
+        fprintf(stderr, "Error al escribir bloque de directorio actualizado\n");
+        return -1;
     }
 
-    DEBUG_PRINT("Archivo '%s' no estaba en el directorio\n", filename);
-    return 0; // No encontrado, pero no es error
+    update_header(image_path, dir_nbr, &dir, filename, 0, loc, 0);
+    dcache_store(image_path, dir_nbr, filename, 0, 0);
+    return 0;
 }
@@ -1,10 +1,17 @@
 // read-write-block.c
 
+#define _POSIX_C_SOURCE 200809L // pread, pwrite, strdup, posix_fallocate
+#define _DEFAULT_SOURCE         // preadv, pwritev
+
 #include <errno.h>
 #include <fcntl.h>
 #include <stdint.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
 #include <unistd.h>
 
 #include "vfs.h"
@@ -12,59 +19,482 @@
 /*
     Estas son las funciones de "mas bajo nivel"
     No escriben nada en caso de error, se supone que los invocadores lo controlan
+
+    Cada imagen se abre una sola vez (la primera vez que se la usa) y el descriptor
+    queda guardado en un struct vfs_dev, que se reutiliza en todas las lecturas y
+    escrituras siguientes con pread/pwrite, sin open/lseek/close por cada bloque.
+
+    Opcionalmente (vfs_set_backend(VFS_BACKEND_MMAP) antes del primer acceso) la imagen
+    completa se mapea en memoria y leer o escribir un bloque es solo un memcpy.
+    Los cambios llegan al archivo con msync en vfs_sync y vfs_close.
+
+    Si no esta mapeada, los bloques pasan por un cache LRU con escritura diferida
+    (block-cache.c). Los bloques sucios se escriben en vfs_sync, vfs_close o al
+    terminar el proceso (atexit), de modo que los comandos no necesitan cerrar la imagen.
+
+    El superbloque se mantiene en memoria en el dispositivo (superblock.c) y tambien se
+    escribe en la imagen recien en vfs_sync/vfs_close, igual que los atime pendientes
+    de la politica lazytime (inode.c). Para que las lecturas y escrituras
+    crudas del bloque 0 sigan viendo lo mismo, una lectura primero baja el superbloque
+    pendiente y una escritura descarta la copia en memoria.
 */
 
-int read_block(const char *image_path, int block_number, void *buffer) {
-    int fd = open(image_path, O_RDONLY);
+// Cantidad maxima de bloques que se transfieren en una sola llamada preadv/pwritev
+#define MAX_IOV_BLOCKS 256
+
+static struct vfs_dev open_devs[VFS_MAX_OPEN_DEVS];
+static int default_backend = VFS_BACKEND_PREAD;
+static int exit_handler_installed = 0;
+
+static void close_all_devs(void) {
+    // Se ejecuta al terminar el proceso: confirma y cierra las imagenes que quedaron abiertas
+    for (int i = 0; i < VFS_MAX_OPEN_DEVS; i++) {
+        if (open_devs[i].path == NULL)
+            continue;
+        if (vfs_close(open_devs[i].path) != 0)
+            fprintf(stderr, "Error al confirmar las escrituras pendientes en la imagen\n");
+    }
+}
+
+void vfs_set_backend(int backend) {
+    // Elige el backend de las imagenes que se abran de aqui en adelante.
+    // Las herramientas que solo leen metadata (vfs-info, vfs-ls, vfs-lsort) piden
+    // VFS_BACKEND_MMAP: se mapea la imagen en memoria en lugar de leer bloque a bloque
+    default_backend = backend;
+}
+
+static void dev_map(struct vfs_dev *dev) {
+    // Intenta mapear la imagen completa; si no se puede, el dispositivo sigue con pread/pwrite
+    struct stat st;
+    if (fstat(dev->fd, &st) != 0 || st.st_size < BLOCK_SIZE ||
+        (uint64_t)st.st_size > (uint64_t)VFS_MAX_BLOCKS * BLOCK_SIZE)
+        return;
+
+    int prot = PROT_READ | (dev->writable ? PROT_WRITE : 0);
+    void *map = mmap(NULL, st.st_size, prot, MAP_SHARED, dev->fd, 0);
+    if (map == MAP_FAILED) {
+        DEBUG_PRINT("No se pudo mapear %s, se usa pread/pwrite\n", dev->path);
+        return;
+    }
+
+    dev->map = map;
+    dev->map_size = st.st_size;
+}
+
+struct vfs_dev *vfs_open(const char *image_path) {
+    // Retorna el dispositivo asociado a image_path, abriendolo si todavia no lo esta
+    // Retorna NULL en caso de error, con errno indicando la causa
+    struct vfs_dev *free_slot = NULL;
+
+    for (int i = 0; i < VFS_MAX_OPEN_DEVS; i++) {
+        if (open_devs[i].path == NULL) {
+            if (free_slot == NULL)
+                free_slot = &open_devs[i];
+        }
+        else if (strcmp(open_devs[i].path, image_path) == 0)
+            return &open_devs[i];
+    }
+
+    if (free_slot == NULL) {
+        errno = EMFILE;
+        return NULL;
+    }
+
+    // Se intenta abrir para lectura y escritura; si la imagen es de solo lectura,
+    // se abre igual y las escrituras fallaran como antes
+    int writable = 1;
+    int fd = open(image_path, O_RDWR);
+    if (fd < 0 && (errno == EACCES || errno == EROFS)) {
+        writable = 0;
+        fd = open(image_path, O_RDONLY);
+    }
     if (fd < 0)
-        return -1;
+        return NULL;
 
-    if (lseek(fd, block_number * BLOCK_SIZE, SEEK_SET) < 0) {
+    char *path = strdup(image_path);
+    if (path == NULL) {
         close(fd);
+        errno = ENOMEM;
+        return NULL;
+    }
+
+    free_slot->path = path;
+    free_slot->fd = fd;
+    free_slot->writable = writable;
+    if (default_backend == VFS_BACKEND_MMAP)
+        dev_map(free_slot);
+    if (free_slot->map == NULL)
+        free_slot->cache = cache_create();
+
+    if (!exit_handler_installed) {
+        atexit(close_all_devs);
+        exit_handler_installed = 1;
+    }
+    DEBUG_PRINT("Imagen %s abierta en fd %d (escritura %d, mmap %d)\n", image_path, fd, writable,
+                free_slot->map != NULL);
+
+    return free_slot;
+}
+
+static struct vfs_dev *find_dev(const char *image_path) {
+    // Retorna el dispositivo ya abierto para image_path, o NULL si no lo esta
+    for (int i = 0; i < VFS_MAX_OPEN_DEVS; i++) {
+        if (open_devs[i].path != NULL && strcmp(open_devs[i].path, image_path) == 0)
+            return &open_devs[i];
+    }
+    return NULL;
+}
+
+static int dev_sync(struct vfs_dev *dev) {
+    // Punto de confirmacion: baja a la imagen todo lo escrito en el dispositivo
+    if (inode_flush_lazy_atimes(dev) != 0)
         return -1;
+
+    if (superblock_flush(dev) != 0)
+        return -1;
+
+    if (cache_flush(dev) != 0)
+        return -1;
+
+    if (dev->map != NULL && dev->map_dirty) {
+        if (msync(dev->map, dev->map_size, MS_SYNC) != 0)
+            return -1;
+        dev->map_dirty = 0;
     }
+    return 0;
+}
 
-    if (read(fd, buffer, BLOCK_SIZE) != BLOCK_SIZE) {
-        close(fd);
+int vfs_sync(const char *image_path) {
+    // Confirma en la imagen las escrituras pendientes, si estaba abierta
+    // Retorna 0 en exito, -1 en error
+    struct vfs_dev *dev = find_dev(image_path);
+    if (dev == NULL)
+        return 0;
+
+    return dev_sync(dev);
+}
+
+int vfs_close(const char *image_path) {
+    // Confirma las escrituras pendientes y cierra el dispositivo asociado a image_path
+    // Retorna 0 en exito, -1 en error
+    struct vfs_dev *dev = find_dev(image_path);
+    if (dev == NULL)
+        return 0;
+
+    aio_destroy(dev->aio);
+    int result = dev_sync(dev);
+    cache_destroy(dev->cache);
+    if (dev->map != NULL)
+        munmap(dev->map, dev->map_size);
+    if (close(dev->fd) != 0)
+        result = -1;
+    free(dev->inode_map);
+    free(dev->lazy_atime);
+    dcache_destroy(dev->dcache);
+    free(dev->path);
+    memset(dev, 0, sizeof(struct vfs_dev));
+    return result;
+}
+
+const uint8_t *block_ptr(const char *image_path, int block_number) {
+    // Retorna un puntero de solo lectura al bloque dentro del mapeo de la imagen,
+    // o NULL si la imagen no esta mapeada (el invocador debe usar read_block)
+    struct vfs_dev *dev = vfs_open(image_path);
+    if (dev == NULL || dev->map == NULL || block_number < 0)
+        return NULL;
+
+    if (block_number == SB_BLOCK_NUMBER && superblock_flush(dev) != 0)
+        return NULL;
+
+    size_t offset = (size_t)block_number * BLOCK_SIZE;
+    if (offset + BLOCK_SIZE > dev->map_size)
+        return NULL;
+
+    return dev->map + offset;
+}
+
+int vfs_cache_stats(const char *image_path, struct vfs_cache_stats *stats) {
+    // Copia en stats los contadores del cache de la imagen (en cero si no usa cache)
+    // Retorna 0, o -1 si no se pudo abrir la imagen
+    struct vfs_dev *dev = vfs_open(image_path);
+    if (dev == NULL)
+        return -1;
+
+    cache_get_stats(dev->cache, stats);
+    return 0;
+}
+
+int dev_pread_block(struct vfs_dev *dev, int block_number, void *buffer) {
+    // Lectura directa de la imagen, sin pasar por el cache
+    off_t offset = (off_t)block_number * BLOCK_SIZE;
+    if (pread(dev->fd, buffer, BLOCK_SIZE, offset) != BLOCK_SIZE)
         return -1;
+
+    return 0;
+}
+
+int dev_pwrite_block(struct vfs_dev *dev, int block_number, const void *buffer) {
+    // Escritura directa en la imagen, sin pasar por el cache
+    off_t offset = (off_t)block_number * BLOCK_SIZE;
+    if (pwrite(dev->fd, buffer, BLOCK_SIZE, offset) != BLOCK_SIZE)
+        return -1;
+
+    return 0;
+}
+
+static int dev_transfer_run(struct vfs_dev *dev, int first_block, void *const *buffers, uint32_t count, int write) {
+    // Transfiere count bloques contiguos de la imagen, desde first_block, con una sola
+    // llamada preadv/pwritev cada MAX_IOV_BLOCKS bloques. Cada bloque usa su propio buffer
+    // Retorna 0 o -1
+    struct iovec iov[MAX_IOV_BLOCKS];
+
+    while (count > 0) {
+        uint32_t n = count < MAX_IOV_BLOCKS ? count : MAX_IOV_BLOCKS;
+        for (uint32_t i = 0; i < n; i++) {
+            iov[i].iov_base = buffers[i];
+            iov[i].iov_len = BLOCK_SIZE;
+        }
+
+        off_t offset = (off_t)first_block * BLOCK_SIZE;
+        ssize_t expected = (ssize_t)n * BLOCK_SIZE;
+        ssize_t done = write ? pwritev(dev->fd, iov, n, offset) : preadv(dev->fd, iov, n, offset);
+        if (done != expected)
+            return -1;
+
+        first_block += n;
+        buffers += n;
+        count -= n;
     }
 
-    close(fd);
     return 0;
 }
 
-int write_block(const char *image_path, int block_number, const void *buffer) {
-    int fd = open(image_path, O_WRONLY);
-    if (fd < 0)
+int dev_preadv_run(struct vfs_dev *dev, int first_block, void *const *buffers, uint32_t count) {
+    // Lectura directa de bloques contiguos, sin pasar por el cache
+    return dev_transfer_run(dev, first_block, buffers, count, 0);
+}
+
+int dev_pwritev_run(struct vfs_dev *dev, int first_block, const void *const *buffers, uint32_t count) {
+    // Escritura directa de bloques contiguos, sin pasar por el cache
+    return dev_transfer_run(dev, first_block, (void *const *)buffers, count, 1);
+}
+
+int dev_read_blocks(struct vfs_dev *dev, const uint32_t *block_numbers, void *const *buffers, uint32_t count) {
+    // Lee count bloques, cada uno en su buffer. Los que estan en el cache se copian desde ahi;
+    // el resto se agrupa en tramos contiguos que se leen con una llamada preadv cada uno.
+    // Los bloques leidos de la imagen no se agregan al cache (son datos de archivos)
+    // Retorna 0 o -1
+    if (dev->map != NULL) {
+        for (uint32_t i = 0; i < count; i++) {
+            if (dev_read_block(dev, block_numbers[i], buffers[i]) != 0)
+                return -1;
+        }
+        return 0;
+    }
+
+    uint32_t i = 0;
+    while (i < count) {
+        if (dev->cache != NULL && cache_lookup(dev, block_numbers[i], buffers[i])) {
+            i++;
+            continue;
+        }
+
+        // Tramo contiguo de bloques que no estan en el cache
+        uint32_t n = 1;
+        while (i + n < count && block_numbers[i + n] == block_numbers[i + n - 1] + 1 &&
+               (dev->cache == NULL || !cache_contains(dev, block_numbers[i + n])))
+            n++;
+
+        if (dev_preadv_run(dev, block_numbers[i], buffers + i, n) != 0)
+            return -1;
+        i += n;
+    }
+
+    return 0;
+}
+
+int dev_write_blocks(struct vfs_dev *dev, const uint32_t *block_numbers, const void *const *buffers,
+                     uint32_t count) {
+    // Escribe count bloques, cada uno desde su buffer. Los que estan en el cache se actualizan
+    // ahi (quedan sucios); el resto se agrupa en tramos contiguos escritos con pwritev
+    // Retorna 0 o -1
+    if (!dev->writable) {
+        errno = EBADF;
         return -1;
+    }
 
-    if (lseek(fd, block_number * BLOCK_SIZE, SEEK_SET) < 0) {
-        close(fd);
+    if (dev->map != NULL) {
+        for (uint32_t i = 0; i < count; i++) {
+            if (dev_write_block(dev, block_numbers[i], buffers[i]) != 0)
+                return -1;
+        }
+        return 0;
+    }
+
+    uint32_t i = 0;
+    while (i < count) {
+        if (dev->cache != NULL && cache_update(dev, block_numbers[i], buffers[i])) {
+            i++;
+            continue;
+        }
+
+        uint32_t n = 1;
+        while (i + n < count && block_numbers[i + n] == block_numbers[i + n - 1] + 1 &&
+               (dev->cache == NULL || !cache_contains(dev, block_numbers[i + n])))
+            n++;
+
+        if (dev_pwritev_run(dev, block_numbers[i], buffers + i, n) != 0)
+            return -1;
+        i += n;
+    }
+
+    return 0;
+}
+
+int dev_read_block(struct vfs_dev *dev, int block_number, void *buffer) {
+    if (block_number < 0) {
+        errno = EINVAL;
         return -1;
     }
 
-    if (write(fd, buffer, BLOCK_SIZE) != BLOCK_SIZE) {
-        close(fd);
+    off_t offset = (off_t)block_number * BLOCK_SIZE;
+    if (dev->map != NULL) {
+        if ((size_t)offset + BLOCK_SIZE > dev->map_size) {
+            errno = EINVAL;
+            return -1;
+        }
+        memcpy(buffer, dev->map + offset, BLOCK_SIZE);
+        return 0;
+    }
+
+    if (dev->cache != NULL)
+        return cache_read(dev, block_number, buffer);
+
+    return dev_pread_block(dev, block_number, buffer);
+}
+
+int dev_write_block(struct vfs_dev *dev, int block_number, const void *buffer) {
+    if (block_number < 0) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    if (!dev->writable) {
+        errno = EBADF;
         return -1;
     }
 
-    close(fd);
+    off_t offset = (off_t)block_number * BLOCK_SIZE;
+    if (dev->map != NULL) {
+        if ((size_t)offset + BLOCK_SIZE > dev->map_size) {
+            errno = EINVAL;
+            return -1;
+        }
+        memcpy(dev->map + offset, buffer, BLOCK_SIZE);
+        dev->map_dirty = 1;
+        return 0;
+    }
+
+    if (dev->cache != NULL)
+        return cache_write(dev, block_number, buffer);
+
+    return dev_pwrite_block(dev, block_number, buffer);
+}
+
+static int sb_before_read(struct vfs_dev *dev, const uint32_t *block_numbers, uint32_t count) {
+    // Si entre los bloques a leer esta el superbloque, lo baja antes al dispositivo
+    if (!dev->sb_dirty)
+        return 0;
+
+    for (uint32_t i = 0; i < count; i++) {
+        if (block_numbers[i] == SB_BLOCK_NUMBER)
+            return superblock_flush(dev);
+    }
     return 0;
 }
 
-int create_block_device(const char *image_path, int total_blocks, int block_size) {
+static void sb_before_write(struct vfs_dev *dev, const uint32_t *block_numbers, uint32_t count) {
+    // Si entre los bloques a escribir esta el superbloque, la copia en memoria deja de valer
+    if (!dev->sb_loaded)
+        return;
+
+    for (uint32_t i = 0; i < count; i++) {
+        if (block_numbers[i] == SB_BLOCK_NUMBER) {
+            dev->sb_loaded = 0;
+            dev->sb_dirty = 0;
+            return;
+        }
+    }
+}
+
+int read_block(const char *image_path, int block_number, void *buffer) {
+    struct vfs_dev *dev = vfs_open(image_path);
+    if (dev == NULL)
+        return -1;
+
+    uint32_t block = block_number;
+    if (sb_before_read(dev, &block, 1) != 0)
+        return -1;
+
+    return dev_read_block(dev, block_number, buffer);
+}
+
+int write_block(const char *image_path, int block_number, const void *buffer) {
+    struct vfs_dev *dev = vfs_open(image_path);
+    if (dev == NULL)
+        return -1;
+
+    uint32_t block = block_number;
+    sb_before_write(dev, &block, 1);
+
+    return dev_write_block(dev, block_number, buffer);
+}
+
+int read_blocks(const char *image_path, const uint32_t *block_numbers, void *const *buffers, uint32_t count) {
+    struct vfs_dev *dev = vfs_open(image_path);
+    if (dev == NULL)
+        return -1;
+
+    if (sb_before_read(dev, block_numbers, count) != 0)
+        return -1;
+
+    return dev_read_blocks(dev, block_numbers, buffers, count);
+}
+
+int write_blocks(const char *image_path, const uint32_t *block_numbers, const void *const *buffers, uint32_t count) {
+    struct vfs_dev *dev = vfs_open(image_path);
+    if (dev == NULL)
+        return -1;
+
+    sb_before_write(dev, block_numbers, count);
+
+    return dev_write_blocks(dev, block_numbers, buffers, count);
+}
+
+int create_block_device(const char *image_path, int total_blocks, int block_size, int sparse) {
+    // Crea la imagen con el tamaño final de una vez (queda llena de ceros).
+    // Si sparse es 0, además reserva el espacio en el disco con posix_fallocate,
+    // así las escrituras posteriores no fallan por falta de espacio
     int fd = open(image_path, O_CREAT | O_EXCL | O_WRONLY, 0644);
     if (fd < 0)
         return -1;
 
-    char zero[BLOCK_SIZE] = {0};
+    off_t size = (off_t)total_blocks * block_size;
+    if (ftruncate(fd, size) != 0) {
+        close(fd);
+        return -1;
+    }
 
-    for (int i = 0; i < total_blocks; i++) {
-        if (write(fd, zero, block_size) != block_size) {
+    if (!sparse) {
+        int err = posix_fallocate(fd, 0, size);
+        if (err != 0) {
             close(fd);
+            errno = err;
             return -1;
         }
     }
-    close(fd);
+
+    if (close(fd) != 0)
+        return -1;
     return 0;
 }
@@ -3,12 +3,141 @@
 #include <errno.h>
 #include <stdint.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <time.h>
 #include <unistd.h>
 
 #include "vfs.h"
 
+/*
+    Plan de transferencia de [offset, offset + len) de un archivo:
+    los bloques que quedan completos dentro del rango se leen o escriben directamente
+    sobre el buffer del usuario; el primero y el ultimo, si quedan parciales, usan
+    los buffers auxiliares head y tail. Todo el rango se transfiere con una sola
+    invocacion a read_blocks / write_blocks.
+*/
+struct transfer_plan {
+    uint32_t count;        // Cantidad de bloques del archivo que toca el rango
+    uint32_t *block_nums;  // Numero de bloque en la imagen de cada uno
+    void **buffers;        // Buffer de cada bloque
+    int head_partial;      // 1 si el primer bloque no se transfiere completo
+    int tail_partial;      // 1 si el ultimo bloque (distinto del primero) no se transfiere completo
+    uint8_t head[BLOCK_SIZE];
+    uint8_t tail[BLOCK_SIZE];
+};
+
+static int plan_transfer(const char *image_path, struct inode *in, uint8_t *data, size_t len, size_t offset,
+                         struct transfer_plan *plan) {
+    // Arma el plan para len > 0 bytes desde offset. Retorna 0 o -1 (ya informado)
+    size_t start_block = offset / BLOCK_SIZE;
+    size_t end_block = (offset + len - 1) / BLOCK_SIZE;
+
+    plan->count = end_block - start_block + 1;
+    plan->block_nums = malloc(plan->count * sizeof(uint32_t));
+    plan->buffers = malloc(plan->count * sizeof(void *));
+    if (plan->block_nums == NULL || plan->buffers == NULL) {
+        fprintf(stderr, "Error: sin memoria para transferir %u bloques\n", plan->count);
+        free(plan->block_nums);
+        free(plan->buffers);
+        return -1;
+    }
+
+    plan->head_partial = (offset % BLOCK_SIZE != 0) || (len < BLOCK_SIZE);
+    plan->tail_partial = plan->count > 1 && (offset + len) % BLOCK_SIZE != 0;
+
+    // Numeros de bloque del rango, recorriendo el mapa del archivo por tramos contiguos
+    struct block_iter it;
+    struct block_run run;
+    uint32_t k = 0;
+    if (block_iter_init(&it, image_path, in, start_block) != 0) {
+        free(plan->block_nums);
+        free(plan->buffers);
+        return -1;
+    }
+    while (k < plan->count && block_iter_next(&it, plan->count - k, &run) > 0) {
+        for (uint32_t b = 0; b < run.len; b++)
+            plan->block_nums[k++] = run.start + b;
+    }
+    if (k < plan->count) {
+        fprintf(stderr, "Error inesperado obteniendo el bloque número %zu del archivo\n", start_block + k);
+        free(plan->block_nums);
+        free(plan->buffers);
+        return -1;
+    }
+
+    for (k = 0; k < plan->count; k++) {
+        size_t i = start_block + k;
+
+        if (k == 0 && plan->head_partial)
+            plan->buffers[k] = plan->head;
+        else if (k == plan->count - 1 && plan->tail_partial)
+            plan->buffers[k] = plan->tail;
+        else
+            plan->buffers[k] = data + (i * BLOCK_SIZE - offset);
+    }
+
+    return 0;
+}
+
+static void free_plan(struct transfer_plan *plan) {
+    free(plan->block_nums);
+    free(plan->buffers);
+}
+
+// Politica de atime elegida para este proceso (VFS_ATIME_*), o -1 para usar la de la imagen
+static int atime_override = -1;
+
+// Con relatime, un atime con mas de esta antiguedad (en segundos) se actualiza igual
+#define RELATIME_MAX_AGE (24 * 60 * 60)
+
+void vfs_set_atime_policy(int policy) {
+    // Reemplaza, para las lecturas de aqui en adelante, la politica de atime guardada
+    // en el superbloque de la imagen. Con -1 se vuelve a usar la de la imagen
+    atime_override = policy;
+}
+
+int inode_update_atime(const char *image_path, uint32_t inode_number, struct inode *in) {
+    // Actualiza el atime del nodo-I leido segun la politica de atime vigente
+    // (la del superbloque, o la elegida con vfs_set_atime_policy)
+    // Retorna 0 o -1 si encuentra un error
+    int policy = atime_override;
+    if (policy < 0) {
+        struct superblock sb;
+        if (read_superblock(image_path, &sb) != 0) {
+            fprintf(stderr, "Error al leer superblock\n");
+            return -1;
+        }
+        policy = sb.atime_policy;
+    }
+
+    uint32_t now = (uint32_t)time(NULL);
+    DEBUG_PRINT("inode_read_data: atime valor anterior %u, politica %s.\n", in->atime, atime_policy_name(policy));
+
+    switch (policy) {
+    case VFS_ATIME_NOATIME:
+        return 0;
+
+    case VFS_ATIME_RELATIME:
+        // Solo si el ultimo acceso es anterior a la ultima modificacion o es viejo
+        if (in->atime > in->mtime && in->atime > in->ctime && now - in->atime < RELATIME_MAX_AGE)
+            return 0;
+        break;
+
+    case VFS_ATIME_LAZYTIME:
+        // Queda en memoria y se escribe en vfs_sync/vfs_close junto con el resto
+        in->atime = now;
+        return inode_set_lazy_atime(image_path, inode_number, now);
+
+    default:
+        break;
+    }
+
+    in->atime = now;
+    DEBUG_PRINT("Actualizando atime del inodo %u a %u.\n", inode_number, in->atime);
+    return write_inode(image_path, inode_number, in);
+}
+
 int inode_write_data(const char *image_path, uint32_t inode_number, void *data_buf, size_t len, size_t offset) {
     // Escribe datos en un archivo, desde un offset dado.
     // Asegura que se asignen bloques si es necesario.
@@ -23,7 +152,7 @@ int inode_write_data(const char *image_path, uint32_t inode_number, void *data_b
     }
 
     // Verificar que offset no supere el tamaño máximo posible
-    size_t max_file_size = (NUM_DIRECT_PTRS + NUM_INDIRECT_PTRS) * BLOCK_SIZE;
+    size_t max_file_size = (size_t)MAX_FILE_BLOCKS * BLOCK_SIZE;
     if (offset + len > max_file_size) {
         fprintf(stderr, "Error: Escritura supera el tamaño máximo permitido del archivo\n");
         return -1;
@@ -43,72 +172,106 @@ int inode_write_data(const char *image_path, uint32_t inode_number, void *data_b
 
     DEBUG_PRINT("final_size %zu, required_blocks %zu in.blocks %u.\n", final_size, required_blocks, in.blocks);
 
+    // Los bloques desde old_blocks se asignan en esta escritura y ya estan en cero
+    // (los bloques se liberan llenos de ceros y la imagen se crea en cero)
+    uint32_t old_blocks = in.blocks;
+
     if (required_blocks > in.blocks) {
         size_t to_allocate = required_blocks - in.blocks;
         DEBUG_PRINT("final_size %zu, required_blocks %zu to_allocate %zu.\n", final_size, required_blocks, to_allocate);
 
-        // Validar si hay suficientes bloques libres
-        if (to_allocate > sb->free_blocks) {
-            fprintf(stderr, "Error: No hay bloques libres suficientes (%zu requeridos)\n", to_allocate);
+        // Validar si hay suficientes bloques libres, contando los de mapa que puede
+        // necesitar agregarlos (bloque de extents o bloques de punteros)
+        size_t needed = to_allocate + inode_extra_map_blocks(&in, required_blocks);
+        if (needed > sb->free_blocks) {
+            fprintf(stderr, "Error: No hay bloques libres suficientes (%zu requeridos)\n", needed);
             return -1;
         }
 
-        // Asignar los bloques necesarios
-        for (size_t i = 0; i < to_allocate; i++) {
-            int new_block = bitmap_set_first_free(image_path);
-            DEBUG_PRINT("bloque adicional es %d\n", new_block);
+        // Reservar los bloques necesarios en tramos contiguos, asi el archivo queda
+        // seguido en la imagen y se escribe el bitmap una vez por tramo
+        uint32_t *new_blocks = malloc(to_allocate * sizeof(uint32_t));
+        if (new_blocks == NULL) {
+            fprintf(stderr, "Error: sin memoria para asignar %zu bloques\n", to_allocate);
+            return -1;
+        }
 
-            if (new_block == -1) {
-                fprintf(stderr, "Error al asignar bloque adicional\n");
-                return -1;
-            }
+        if (bitmap_alloc_blocks(image_path, to_allocate, new_blocks) != 0) {
+            fprintf(stderr, "Error al asignar bloques adicionales\n");
+            free(new_blocks);
+            return -1;
+        }
 
-            if (inode_append_block(image_path, &in, new_block) != 0) {
-                return -1;
-            }
+        if (inode_append_blocks(image_path, &in, new_blocks, to_allocate) != 0) {
+            // inode_append_blocks ya dejó el mapa como estaba y el nodo-I no se escribe:
+            // los bloques reservados no quedan en ningún archivo
+            if (bitmap_free_blocks(image_path, new_blocks, to_allocate, 1) != 0)
+                fprintf(stderr, "Error al liberar %zu bloques reservados\n", to_allocate);
+            free(new_blocks);
+            return -1;
         }
+        free(new_blocks);
     }
 
     // Empezar a escribir los datos
-    uint8_t block_buf[BLOCK_SIZE];
     uint8_t *src = (uint8_t *)data_buf;
-    size_t remaining = len;
-
-    size_t start_block = offset / BLOCK_SIZE;
     size_t start_offset = offset % BLOCK_SIZE;
 
-    DEBUG_PRINT("start_block: %zd start_offset: %zd.\n", start_block, start_offset);
+    DEBUG_PRINT("start_block: %zd start_offset: %zd.\n", offset / BLOCK_SIZE, start_offset);
 
-    for (size_t i = start_block; remaining > 0; i++) {
-        int block_num = get_block_number_at(image_path, &in, i);
-        if (block_num <= 0) {
-            fprintf(stderr, "Error inesperado obteniendo el bloque número %zu del archivo\n", i);
+    if (len > 0) {
+        struct transfer_plan plan;
+        if (plan_transfer(image_path, &in, src, len, offset, &plan) != 0)
             return -1;
+
+        // Los bloques parciales que ya eran del archivo se leen primero, para conservar lo
+        // que no se sobrescribe; los recien asignados solo se ponen en cero en memoria.
+        // Los bloques completos se escriben directo del buffer del usuario, sin leerlos
+        size_t start_block = offset / BLOCK_SIZE;
+        uint32_t partial_nums[2];
+        void *partial_bufs[2];
+        uint32_t partial_count = 0;
+        if (plan.head_partial) {
+            if (start_block >= old_blocks)
+                memset(plan.head, 0, BLOCK_SIZE);
+            else {
+                partial_nums[partial_count] = plan.block_nums[0];
+                partial_bufs[partial_count++] = plan.head;
+            }
+        }
+        if (plan.tail_partial) {
+            if (start_block + plan.count - 1 >= old_blocks)
+                memset(plan.tail, 0, BLOCK_SIZE);
+            else {
+                partial_nums[partial_count] = plan.block_nums[plan.count - 1];
+                partial_bufs[partial_count++] = plan.tail;
+            }
         }
 
-        // Leer el bloque actual del archivo
-        if (read_block(image_path, block_num, block_buf) != 0) {
-            fprintf(stderr, "Error inesperado leyendo bloque %d\n", block_num);
+        if (partial_count > 0 && read_blocks(image_path, partial_nums, partial_bufs, partial_count) != 0) {
+            fprintf(stderr, "Error inesperado leyendo bloque %u\n", partial_nums[0]);
+            free_plan(&plan);
             return -1;
         }
 
-        // Calcular cuánto escribir en este bloque
-        size_t write_offset = (i == start_block) ? start_offset : 0;
-        size_t space = BLOCK_SIZE - write_offset;
-        size_t to_write = (remaining < space) ? remaining : space;
-
-        memcpy(block_buf + write_offset, src, to_write);
+        if (plan.head_partial) {
+            size_t space = BLOCK_SIZE - start_offset;
+            memcpy(plan.head + start_offset, src, len < space ? len : space);
+        }
+        if (plan.tail_partial) {
+            size_t tail_start = (offset + len) / BLOCK_SIZE * BLOCK_SIZE;
+            memcpy(plan.tail, src + (tail_start - offset), offset + len - tail_start);
+        }
 
-        DEBUG_PRINT("Escribiendo bloque %d, Write offset %zu, space %zu, towrite %zu.\n", block_num, write_offset,
-                    space, to_write);
+        DEBUG_PRINT("Escribiendo %u bloques desde el bloque %u.\n", plan.count, plan.block_nums[0]);
 
-        if (write_block(image_path, block_num, block_buf) != 0) {
-            fprintf(stderr, "Error escribiendo bloque %d\n", block_num);
+        if (write_blocks(image_path, plan.block_nums, (const void *const *)plan.buffers, plan.count) != 0) {
+            fprintf(stderr, "Error escribiendo bloque %u\n", plan.block_nums[0]);
+            free_plan(&plan);
             return -1;
         }
 
-        src += to_write;
-        remaining -= to_write;
+        free_plan(&plan);
     }
 
     // Actualizar tamaño si se escribió más allá del tamaño anterior
@@ -154,45 +317,38 @@ int inode_read_data(const char *image_path, uint32_t inode_number, void *data_bu
         DEBUG_PRINT("Ajustando longitud de lectura a %zu bytes.\n", len);
     }
 
-    uint8_t block_buf[BLOCK_SIZE];
     uint8_t *dst = (uint8_t *)data_buf;
-    size_t remaining = len;
-
-    size_t start_block = offset / BLOCK_SIZE;
     size_t start_offset = offset % BLOCK_SIZE;
 
-    for (size_t i = start_block; remaining > 0; i++) {
-        int block_num = get_block_number_at(image_path, &in, i);
-        if (block_num <= 0) {
-            fprintf(stderr, "Error inesperado obteniendo el bloque número %zu del archivo\n", i);
+    if (len > 0) {
+        struct transfer_plan plan;
+        if (plan_transfer(image_path, &in, dst, len, offset, &plan) != 0)
             return -1;
-        }
 
-        if (read_block(image_path, block_num, block_buf) != 0) {
-            fprintf(stderr, "Error leyendo bloque %d\n", block_num);
+        DEBUG_PRINT("Leyendo %u bloques desde el bloque %u.\n", plan.count, plan.block_nums[0]);
+
+        // Con io_uring se mantienen varias lecturas en vuelo a la vez
+        if (read_blocks_prefetch(image_path, plan.block_nums, plan.buffers, plan.count) != 0) {
+            fprintf(stderr, "Error leyendo bloque %u\n", plan.block_nums[0]);
+            free_plan(&plan);
             return -1;
         }
 
-        size_t read_offset = (i == start_block) ? start_offset : 0;
-        size_t space = BLOCK_SIZE - read_offset;
-        size_t to_read = (remaining < space) ? remaining : space;
-
-        memcpy(dst, block_buf + read_offset, to_read);
-
-        DEBUG_PRINT("Leyendo bloque %d, Read offset %zu, space %zu, to_read %zu.\n", block_num, read_offset, space,
-                    to_read);
+        // Copiar al buffer del usuario la parte que corresponde de los bloques parciales
+        if (plan.head_partial) {
+            size_t space = BLOCK_SIZE - start_offset;
+            memcpy(dst, plan.head + start_offset, len < space ? len : space);
+        }
+        if (plan.tail_partial) {
+            size_t tail_start = (offset + len) / BLOCK_SIZE * BLOCK_SIZE;
+            memcpy(dst + (tail_start - offset), plan.tail, offset + len - tail_start);
+        }
 
-        dst += to_read;
-        remaining -= to_read;
+        free_plan(&plan);
     }
 
-    // Actualizar solo el atime
-    DEBUG_PRINT("inode_read_data: atime valor anterior %u.\n", in.atime);
-    time_t now = time(NULL);
-    in.atime = (uint32_t)now;
-    DEBUG_PRINT("Actualizando atime del inodo %u a %u.\n", inode_number, in.atime);
-
-    if (write_inode(image_path, inode_number, &in) != 0) {
+    // Actualizar solo el atime, segun la politica de atime
+    if (inode_update_atime(image_path, inode_number, &in) != 0) {
         fprintf(stderr, "Error al actualizar el atime del inodo %u.\n", inode_number);
         return -1;
     }
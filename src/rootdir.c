@@ -10,62 +10,125 @@
 
 #include "vfs.h"
 
-int create_root_dir(const char *image_path) {
+static int init_dir(const char *image_path, uint32_t dir_nbr, uint32_t parent_nbr, struct inode *in) {
+    // Arma el directorio dir_nbr: un bloque con las entradas . y .., el nodo-I in (con el
+    // modo, dueño y fechas ya puestos) y su cabecera
+    // Retorna 0 o -1
+    int data_block = bitmap_set_first_free(image_path);
+    DEBUG_PRINT("Bloque del directorio %u: %d.\n", dir_nbr, data_block);
+    if (data_block == -1) {
+        fprintf(stderr, "No hay bloques disponibles para el bloque del directorio.\n");
+        return -1;
+    }
 
-    struct superblock sb_str, *sb = &sb_str;
+    // Agregar las entradas . (el directorio) y .. (su padre)
+    uint8_t data_buffer[BLOCK_SIZE] = {0};
+    struct dir_entry *entries = (struct dir_entry *)data_buffer;
+    entries[0].inode = dir_nbr;
+    strncpy(entries[0].name, ".", FILENAME_MAX_LEN);
+    entries[1].inode = parent_nbr;
+    strncpy(entries[1].name, "..", FILENAME_MAX_LEN);
 
-    if (read_superblock(image_path, sb) != 0) {
+    // Actualizar y escribir el bloque de datos del directorio
+    if (write_block(image_path, data_block, data_buffer) != 0) {
         return -1;
     }
 
-    if (sb->free_inodes == 0 || sb->free_blocks == 0) {
+    // El directorio usa el mapa de punteros, con un solo bloque
+    memset(in->direct, 0, sizeof(in->direct));
+    in->indirect = in->dindirect = in->tindirect = 0;
+    in->blocks = 1;
+    in->size = BLOCK_SIZE;
+    in->direct[0] = data_block;
+
+    if (write_inode(image_path, dir_nbr, in) != 0)
+        return -1;
+
+    // Cabecera vacia: el indice hash, el arbol de nombres y el filtro de Bloom se arman
+    // cuando el directorio pasa de un bloque (ver update_header en ls-func.c)
+    struct dir_header hdr;
+    memset(&hdr, 0, sizeof(hdr));
+    strcpy(hdr.dot, ".");
+    if (dir_header_write(image_path, in, &hdr) != 0) {
+        fprintf(stderr, "Error: no se pudo escribir la cabecera del directorio %u\n", dir_nbr);
         return -1;
     }
 
-    // Reservar un bloque de datos para el directorio
-    int rootdir_data_block = bitmap_set_first_free(image_path);
-    DEBUG_PRINT("rootdir block %d.\n", rootdir_data_block);
-    if (rootdir_data_block == -1) {
-        fprintf(stderr, "No hay bloques disponibles para el bloque del directorio raiz.\n");
+    return 0;
+}
+
+int create_root_dir(const char *image_path) {
+
+    struct superblock sb_str, *sb = &sb_str;
+
+    if (read_superblock(image_path, sb) != 0) {
         return -1;
     }
 
-    // Agregar las entradas . y .. del directorio raiz, que son referencias a si mismo
-    uint8_t data_buffer[BLOCK_SIZE] = {0};
-    struct dir_entry *entries = (struct dir_entry *)data_buffer;
-    entries[0].inode = ROOTDIR_INODE;
-    strncpy(entries[0].name, ".", FILENAME_MAX_LEN);
-    entries[1].inode = ROOTDIR_INODE;
-    strncpy(entries[1].name, "..", FILENAME_MAX_LEN);
+    if (sb->free_inodes == 0 || sb->free_blocks == 0) {
+        return -1;
+    }
 
-    // Actualizar y escribir el bloque de datos del directorio
-    if (write_block(image_path, rootdir_data_block, data_buffer) != 0) {
+    // El nodo-i del directorio raíz esta en la posicion ROOTDIR_INODE, siempre ocupada
+    sb->free_inodes--;
+    if (write_superblock(image_path, sb) != 0) {
+        fprintf(stderr, "Error: no se pudo escribir el superbloque\n");
         return -1;
     }
 
-    // Crear el nodo-i en la posicion ROOTDIR_INODE (directorio raíz)
+    // Crear el nodo-i del directorio raíz, que es su propio padre
     struct inode in = {0};  // por defecto, todo inicializado en 0
     in.mode = INODE_MODE_DIR | 0755;
     in.uid = getuid();
     in.gid = getgid();
-    in.blocks = 1;
-    in.size = BLOCK_SIZE;
-    in.direct[0] = rootdir_data_block;
     time_t now = time(NULL);
     in.atime = in.mtime = in.ctime = (uint32_t)now;
 
-    if (write_inode(image_path, ROOTDIR_INODE, &in) != 0)
+    return init_dir(image_path, ROOTDIR_INODE, ROOTDIR_INODE, &in);
+}
+
+int create_dir(const char *image_path, uint32_t parent_inode, uint16_t perms) {
+    // Crea un directorio vacio (solo . y ..) en un nodo-I libre, con padre parent_inode
+    // No lo agrega al padre: eso lo hace el invocador con add_dir_entry
+    // Retorna el nro de nodo-I del directorio, o -1 en caso de error
+    int dir_nbr = create_empty_file_in_free_inode(image_path, perms);
+    if (dir_nbr < 0)
         return -1;
 
-    // Actualizar y re-escribir el superbloque
-    if (read_superblock(image_path, sb) != 0) {
+    struct inode in;
+    if (read_inode(image_path, dir_nbr, &in) != 0) {
+        free_inode(image_path, dir_nbr);
         return -1;
     }
-    sb->free_inodes--;
-    if (write_superblock(image_path, sb) != 0) {
-        fprintf(stderr, "Error: no se pudo escribir el superbloque\n");
+    in.mode = INODE_MODE_DIR | perms;
+
+    if (init_dir(image_path, dir_nbr, parent_inode, &in) != 0) {
+        free_dir(image_path, dir_nbr);
+        return -1;
+    }
+
+    return dir_nbr;
+}
+
+int free_dir(const char *image_path, uint32_t dir_inode) {
+    // Libera un directorio que ya no figura en su padre: su indice hash, su arbol de
+    // nombres, su filtro de Bloom, sus bloques y su nodo-I. No revisa que este vacio
+    // Retorna 0 o -1
+    struct inode in;
+    if (read_inode(image_path, dir_inode, &in) != 0)
+        return -1;
+
+    struct dir_header hdr;
+    if (dir_header_read(image_path, dir_inode, &in, &hdr) == 1) {
+        dir_hash_drop(image_path, &hdr);
+        dir_tree_drop(image_path, &hdr);
+        dir_bloom_drop(image_path, &hdr);
+    }
+
+    if (inode_trunc_data(image_path, &in) != 0 || free_inode(image_path, dir_inode) != 0) {
+        fprintf(stderr, "Error al liberar el directorio (nodo-I %u)\n", dir_inode);
         return -1;
     }
 
     return 0;
-}
\ No newline at end of file
+}
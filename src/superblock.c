@@ -23,14 +23,36 @@ void print_superblock(const struct superblock *sb) {
     printf("  Inode start block: %u\n", sb->inode_start);
     printf("  Bitmap start block: %u\n", sb->bitmap_start);
     printf("  Data start block: %u\n", sb->data_start);
+    printf("  Atime policy: %s\n", atime_policy_name(sb->atime_policy));
 }
 
-int read_superblock(const char *image_path, struct superblock *sb) {
-    // Lee el superbloque de la imagen y lo copia en `sb`.
+static const char *atime_policy_names[] = {"strict", "relatime", "noatime", "lazytime"};
+
+int atime_policy_from_name(const char *name) {
+    // Retorna la politica VFS_ATIME_* de nombre name, o -1 si no existe
+    for (int i = 0; i < (int)(sizeof(atime_policy_names) / sizeof(atime_policy_names[0])); i++) {
+        if (strcmp(name, atime_policy_names[i]) == 0)
+            return i;
+    }
+    return -1;
+}
+
+const char *atime_policy_name(uint32_t policy) {
+    // Nombre de la politica VFS_ATIME_*, o "desconocida"
+    if (policy >= sizeof(atime_policy_names) / sizeof(atime_policy_names[0]))
+        return "desconocida";
+    return atime_policy_names[policy];
+}
+
+static int load_superblock(struct vfs_dev *dev) {
+    // Lee el superbloque de la imagen al dispositivo, si todavia no esta cargado
     // Retorna 0 en caso de éxito, -1 en caso de error.
+    if (dev->sb_loaded)
+        return 0;
+
     uint8_t buffer[BLOCK_SIZE];
 
-    if (read_block(image_path, SB_BLOCK_NUMBER, buffer) != 0) {
+    if (dev_read_block(dev, SB_BLOCK_NUMBER, buffer) != 0) {
         fprintf(stderr, "Error al leer el superbloque: %s\n", strerror(errno));
         return -1;
     }
@@ -42,39 +64,79 @@ int read_superblock(const char *image_path, struct superblock *sb) {
         return -1;
     }
 
-    memcpy(sb, sb_buf, sizeof(struct superblock));
+    memcpy(&dev->sb, sb_buf, sizeof(struct superblock));
+    dev->sb_loaded = 1;
     return 0;
 }
 
-int write_superblock(const char *image_path, struct superblock *sb) {
-    // Escribe el superbloque de la imagen a partir de `sb`.
+int read_superblock(const char *image_path, struct superblock *sb) {
+    // Copia en `sb` el superbloque de la imagen.
+    // Se lee de la imagen una sola vez; despues se usa la copia en memoria del dispositivo,
+    // que es la que vale mientras la imagen esta abierta.
     // Retorna 0 en caso de éxito, -1 en caso de error.
+    struct vfs_dev *dev = vfs_open(image_path);
+    if (dev == NULL) {
+        fprintf(stderr, "Error al leer el superbloque: %s\n", strerror(errno));
+        return -1;
+    }
 
-    uint8_t buffer[BLOCK_SIZE] = {0};
-    memcpy(buffer, sb, sizeof(struct superblock));
+    if (load_superblock(dev) != 0)
+        return -1;
+
+    memcpy(sb, &dev->sb, sizeof(struct superblock));
+    return 0;
+}
+
+int write_superblock(const char *image_path, struct superblock *sb) {
+    // Actualiza el superbloque de la imagen a partir de `sb`.
+    // Solo se modifica la copia en memoria; se escribe en la imagen en vfs_sync/vfs_close,
+    // asi varias asignaciones seguidas cuestan una sola escritura del superbloque.
+    // Retorna 0 en caso de éxito, -1 en caso de error.
 
     if (sb->magic != MAGIC_NUMBER) {
         fprintf(stderr, "Error: la estructura no contiene un MAGIC_NUMBER válido\n");
         return -1;
     }
 
-    if (write_block(image_path, SB_BLOCK_NUMBER, buffer) != 0) {
+    struct vfs_dev *dev = vfs_open(image_path);
+    if (dev == NULL || !dev->writable) {
+        if (dev != NULL)
+            errno = EBADF;
         fprintf(stderr, "Error al escribir el superbloque: %s\n", strerror(errno));
         return -1;
     }
 
+    memcpy(&dev->sb, sb, sizeof(struct superblock));
+    dev->sb_loaded = 1;
+    dev->sb_dirty = 1;
+    return 0;
+}
+
+int superblock_flush(struct vfs_dev *dev) {
+    // Escribe en la imagen el superbloque en memoria, si fue modificado
+    // Retorna 0 en caso de éxito, -1 en caso de error.
+    if (!dev->sb_dirty)
+        return 0;
+
+    uint8_t buffer[BLOCK_SIZE] = {0};
+    memcpy(buffer, &dev->sb, sizeof(struct superblock));
+
+    if (dev_write_block(dev, SB_BLOCK_NUMBER, buffer) != 0) {
+        fprintf(stderr, "Error al escribir el superbloque: %s\n", strerror(errno));
+        return -1;
+    }
+
+    dev->sb_dirty = 0;
     return 0;
 }
 
 int init_superblock(const char *image_path, uint32_t total_blocks, uint32_t total_inodes) {
 
-    uint8_t superblock_buffer[BLOCK_SIZE] = {0};
-    // Acceder a la estructura de superbloque usando un puntero
-    struct superblock *sb = (struct superblock *)superblock_buffer;
+    struct superblock sb_struct = {0}, *sb = &sb_struct;
 
     sb->magic = MAGIC_NUMBER;
     sb->block_size = BLOCK_SIZE;
-    sb->total_blocks = sb->free_blocks = total_blocks;
+    sb->total_blocks = total_blocks;
     sb->superblock_blocks = 1;
     sb->inode_blocks = total_inodes / INODES_PER_BLOCK;
     sb->bitmap_blocks = (sb->total_blocks + BITS_PER_BLOCK - 1) / BITS_PER_BLOCK;
@@ -84,29 +146,50 @@ int init_superblock(const char *image_path, uint32_t total_blocks, uint32_t tota
     sb->inode_start = sb->superblock_blocks;
     sb->bitmap_start = sb->inode_start + sb->inode_blocks;
     sb->data_start = sb->bitmap_start + sb->bitmap_blocks;
+    sb->next_free_inode = ROOTDIR_INODE + 1;
+
+    // Marcar en el bitmap los bloques de metadatos [0, data_start) como ocupados.
+    // Se arma directamente cada bloque de bitmap afectado y se escriben todos juntos;
+    // el resto del bitmap ya está en cero en la imagen recién creada
+    uint32_t used_bitmap_blocks = (sb->data_start + BITS_PER_BLOCK - 1) / BITS_PER_BLOCK;
+    static uint8_t bitmap_buffers[MAX_INODE_BLOCKS][BLOCK_SIZE];
+    uint32_t bitmap_nums[MAX_INODE_BLOCKS];
+    const void *bitmap_bufs[MAX_INODE_BLOCKS];
+
+    for (uint32_t i = 0; i < sb->bitmap_blocks; i++) {
+        // Bits del bloque i que existen en la imagen (el ultimo bloque puede quedar incompleto)
+        uint32_t bits = sb->total_blocks - i * BITS_PER_BLOCK;
+        if (bits > BITS_PER_BLOCK)
+            bits = BITS_PER_BLOCK;
+
+        uint32_t used = 0;
+        if (i < used_bitmap_blocks) {
+            used = sb->data_start - i * BITS_PER_BLOCK;
+            if (used > BITS_PER_BLOCK)
+                used = BITS_PER_BLOCK;
+
+            uint8_t *bitmap = bitmap_buffers[i];
+            memset(bitmap, 0, BLOCK_SIZE);
+            memset(bitmap, 0xFF, used / 8);
+            if (used % 8 != 0)
+                bitmap[used / 8] = (uint8_t)(0xFF << (8 - used % 8));
+
+            bitmap_nums[i] = sb->bitmap_start + i;
+            bitmap_bufs[i] = bitmap;
+        }
 
-    // Inicializar bitmap_zeroes[]
-    sb->bitmap_zeroes[0] = BITS_PER_BLOCK - sb->data_start;
-    for (uint32_t i = 1; i < sb->bitmap_blocks; i++) {
-        sb->bitmap_zeroes[i] = BITS_PER_BLOCK;
+        sb->bitmap_zeroes[i] = bits - used;
     }
+    sb->free_blocks = sb->total_blocks - sb->data_start;
 
-    if (write_block(image_path, SB_BLOCK_NUMBER, superblock_buffer) != 0) {
-        fprintf(stderr, "Error: no se pudo escribir el superbloque\n");
+    if (write_blocks(image_path, bitmap_nums, bitmap_bufs, used_bitmap_blocks) != 0) {
+        fprintf(stderr, "Error: no se pudo escribir el bitmap\n");
         return -1;
     }
 
-    sb->free_blocks = sb->total_blocks; // cada invocación a bitmap_set_first_free lo decrementa
-    for (uint32_t i = 0; i < sb->data_start; i++) {
-        // prende el bit en el bitmap y decrementa free_blocks
-
-        int first_free = bitmap_set_first_free(image_path);
-        DEBUG_PRINT("first free block %u.\n", first_free);
-
-        if (first_free != (int)i) {
-            fprintf(stderr, "Error inesperado asignando bloques libres\n");
-            return -1;
-        }
+    if (write_superblock(image_path, sb) != 0) {
+        fprintf(stderr, "Error: no se pudo escribir el superbloque\n");
+        return -1;
     }
 
     return 0;
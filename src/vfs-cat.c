@@ -1,23 +1,185 @@
 // src/vfs-cat.c
 
+#define _POSIX_C_SOURCE 200809L // fileno, isatty
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdint.h>
 #include <string.h>
 #include <errno.h>
+#include <sys/sendfile.h>
+#include <unistd.h>
 
 #include "vfs.h"
 
+// Cantidad maxima de bloques del archivo cuya lectura se adelanta mientras se escribe el actual
+#define CAT_PREFETCH_BLOCKS 64
+
+static void cat_file(const char *image_path, const char *filename, struct inode *in) {
+    // Escribe en stdout el contenido del archivo, bloque por bloque
+    // Mientras se escribe un bloque, las lecturas de los siguientes ya estan encoladas en
+    // el motor asincronico (io_uring si esta disponible), hasta CAT_PREFETCH_BLOCKS
+    static uint8_t buffer[CAT_PREFETCH_BLOCKS][BLOCK_SIZE];
+    uint32_t block_nums[CAT_PREFETCH_BLOCKS];
+    int slots[CAT_PREFETCH_BLOCKS];
+
+    struct vfs_aio *aio = vfs_aio_get(image_path);
+    if (aio == NULL) {
+        fprintf(stderr, "Error al abrir la imagen para leer '%s'\n", filename);
+        return;
+    }
+
+    uint32_t window = vfs_aio_depth(aio) < CAT_PREFETCH_BLOCKS ? vfs_aio_depth(aio) : CAT_PREFETCH_BLOCKS;
+    uint32_t nblocks = (in->size + BLOCK_SIZE - 1) / BLOCK_SIZE;
+    if (nblocks > in->blocks)
+        nblocks = in->blocks;
+
+    // Los bloques del archivo se toman del mapa por tramos contiguos
+    struct block_iter it;
+    struct block_run run = {0, 0};
+    if (block_iter_init(&it, image_path, in, 0) != 0) {
+        fprintf(stderr, "Error al leer el mapa de bloques del archivo '%s'\n", filename);
+        return;
+    }
+
+    uint32_t bytes_remaining = in->size;
+    uint32_t submitted = 0;
+    uint32_t j;
+    int failed = 0;
+
+    for (j = 0; j < nblocks; j++) {
+        // Mantener encoladas las lecturas de los bloques que siguen
+        while (!failed && submitted < nblocks && submitted < j + window) {
+            uint32_t k = submitted % window;
+            if (run.len == 0 && block_iter_next(&it, nblocks - submitted, &run) <= 0) {
+                fprintf(stderr, "Error al obtener bloque %u del archivo '%s'\n", submitted, filename);
+                failed = 1;
+                break;
+            }
+            block_nums[k] = run.start++;
+            run.len--;
+            slots[k] = vfs_aio_submit_read(aio, block_nums[k], buffer[k]);
+            submitted++;
+        }
+        vfs_aio_kick(aio);
+
+        if (j >= submitted)
+            break;
+
+        uint32_t k = j % window;
+        if (slots[k] < 0 || vfs_aio_complete(aio, slots[k]) != 0) {
+            fprintf(stderr, "Error al leer bloque %u del archivo '%s'\n", block_nums[k], filename);
+            j++;
+            break;
+        }
+
+        size_t to_print = (bytes_remaining < BLOCK_SIZE) ? bytes_remaining : BLOCK_SIZE;
+        fwrite(buffer[k], 1, to_print, stdout);
+        bytes_remaining -= to_print;
+    }
+
+    // Si se corto por un error, esperar las lecturas que quedaron en vuelo
+    for (; j < submitted; j++) {
+        if (slots[j % window] >= 0)
+            vfs_aio_complete(aio, slots[j % window]);
+    }
+}
+
+static int cat_file_sendfile(const char *image_path, const char *filename, struct inode *in) {
+    // Copia el archivo a stdout sin pasar por memoria del proceso: cada tramo de bloques
+    // contiguos del archivo se pasa con sendfile directamente del descriptor de la imagen
+    // Retorna 0 si lo copio, 1 si sendfile no sirve para esta salida (no se escribio nada
+    // y hay que usar cat_file) o -1 en caso de error (ya informado)
+    struct vfs_dev *dev = vfs_open(image_path);
+    if (dev == NULL) {
+        fprintf(stderr, "Error al abrir la imagen para leer '%s'\n", filename);
+        return -1;
+    }
+
+    // Lo ya escrito en stdout va primero, y sendfile lee la imagen, no el cache de bloques
+    fflush(stdout);
+    if (vfs_sync(image_path) != 0) {
+        fprintf(stderr, "Error al confirmar las escrituras pendientes en la imagen\n");
+        return -1;
+    }
+
+    uint32_t nblocks = (in->size + BLOCK_SIZE - 1) / BLOCK_SIZE;
+    if (nblocks > in->blocks)
+        nblocks = in->blocks;
+
+    struct block_iter it;
+    struct block_run run;
+    if (block_iter_init(&it, image_path, in, 0) != 0) {
+        fprintf(stderr, "Error al leer el mapa de bloques del archivo '%s'\n", filename);
+        return -1;
+    }
+
+    int out_fd = fileno(stdout);
+    size_t bytes_remaining = in->size;
+    uint32_t done = 0;
+    int first = 1;
+
+    while (done < nblocks && bytes_remaining > 0) {
+        if (block_iter_next(&it, nblocks - done, &run) <= 0) {
+            fprintf(stderr, "Error al obtener bloque %u del archivo '%s'\n", done, filename);
+            return -1;
+        }
+        done += run.len;
+
+        off_t offset = (off_t)run.start * BLOCK_SIZE;
+        size_t count = (size_t)run.len * BLOCK_SIZE;
+        if (count > bytes_remaining)
+            count = bytes_remaining;
+
+        while (count > 0) {
+            ssize_t sent = sendfile(out_fd, dev->fd, &offset, count);
+            if (sent <= 0) {
+                if (sent < 0 && errno == EINTR)
+                    continue;
+                if (first && sent < 0 && (errno == EINVAL || errno == ENOSYS))
+                    return 1;
+                fprintf(stderr, "Error al escribir el archivo '%s': %s\n", filename,
+                        sent < 0 ? strerror(errno) : "escritura incompleta");
+                return -1;
+            }
+            first = 0;
+            count -= sent;
+            bytes_remaining -= sent;
+        }
+    }
+
+    return 0;
+}
+
 // Este programa muestra el contenido de uno o más archivos del sistema de archivos virtual
 int main(int argc, char *argv[]) {
+    const char *prog = argv[0];
+
+    // --atime=<politica> reemplaza, solo en esta invocación, la política de la imagen
+    if (argc > 1 && strncmp(argv[1], "--atime=", 8) == 0) {
+        int policy = atime_policy_from_name(argv[1] + 8);
+        if (policy < 0) {
+            fprintf(stderr, "Error: politica de atime desconocida '%s'\n", argv[1] + 8);
+            return 1;
+        }
+        vfs_set_atime_policy(policy);
+        argc--;
+        argv++;
+    }
+
     // Verifica que se pase la imagen y al menos un archivo como argumento
     if (argc < 3) {
-        fprintf(stderr, "Uso: %s <imagen> <archivo1> [archivo2...]\n", argv[0]);
+        fprintf(stderr, "Uso: %s [--atime=strict|relatime|noatime|lazytime] <imagen> <archivo1> [archivo2...]\n",
+                prog);
         return 1;
     }
 
     const char *image_path = argv[1];
 
+    // En una terminal se escribe con stdio, bloque por bloque; a un archivo o a un pipe
+    // el contenido va directo de la imagen a la salida
+    int zero_copy = !isatty(fileno(stdout));
+
     // Recorre cada archivo solicitado
     for (int i = 2; i < argc; i++) {
         const char *filename = argv[i];
@@ -42,25 +204,27 @@ int main(int argc, char *argv[]) {
             continue;
         }
 
-        // Lee y muestra el contenido del archivo bloque por bloque
-        uint32_t bytes_remaining = in.size;
-        for (uint16_t j = 0; j < in.blocks && bytes_remaining > 0; j++) {
-            int block_num = get_block_number_at(image_path, &in, j);
-            if (block_num <= 0) {
-                fprintf(stderr, "Error al obtener bloque %d del archivo '%s'\n", j, filename);
-                break;
+        if (zero_copy) {
+            int result = cat_file_sendfile(image_path, filename, &in);
+            if (result < 0)
+                continue;
+            if (result > 0) {
+                zero_copy = 0;
+                cat_file(image_path, filename, &in);
             }
+        }
+        else
+            cat_file(image_path, filename, &in);
 
-            uint8_t buffer[BLOCK_SIZE];
-            if (read_block(image_path, block_num, buffer) != 0) {
-                fprintf(stderr, "Error al leer bloque %d del archivo '%s'\n", block_num, filename);
-                break;
-            }
+        // Registra el acceso según la política de atime (ver inode_update_atime)
+        if (inode_update_atime(image_path, inode_number, &in) != 0)
+            fprintf(stderr, "Error al actualizar el atime del archivo '%s'\n", filename);
+    }
 
-            size_t to_print = (bytes_remaining < BLOCK_SIZE) ? bytes_remaining : BLOCK_SIZE;
-            fwrite(buffer, 1, to_print, stdout);
-            bytes_remaining -= to_print;
-        }
+    // Escribe en la imagen los atime que quedaron en la caché
+    if (vfs_close(image_path) != 0) {
+        fprintf(stderr, "Error al escribir los cambios en la imagen %s\n", image_path);
+        return 1;
     }
 
     return 0;
@@ -1,16 +1,75 @@
 // vfs-copy.c
 
+#define _POSIX_C_SOURCE 200809L // posix_madvise
+
 #include <ctype.h>
 #include <errno.h>
 #include <fcntl.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/mman.h>
 #include <sys/stat.h>
 #include <unistd.h>
 
 #include "vfs.h"
 
+// Tamaño del buffer (en bloques) cuando el archivo origen no se puede mapear
+#define COPY_BUFFER_BLOCKS 256
+
+static int copy_mapped(const char *image_path, int new_inode, int fd, size_t size) {
+    // Copia el archivo origen mapeado en memoria con una sola escritura: inode_write_data
+    // reserva todos los bloques de una vez y escribe el nodo-I una sola vez
+    // Retorna 0, 1 si no se pudo mapear (hay que leerlo con read) o -1 en caso de error
+    void *map = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (map == MAP_FAILED)
+        return 1;
+    posix_madvise(map, size, POSIX_MADV_SEQUENTIAL);
+
+    int result = 0;
+    if (inode_write_data(image_path, new_inode, map, size, 0) != (int)size) {
+        fprintf(stderr, "Error al escribir datos en VFS, nodo-I nro %d, %zu bytes.\n", new_inode, size);
+        result = -1;
+    }
+
+    munmap(map, size);
+    return result;
+}
+
+static int copy_read(const char *image_path, int new_inode, int fd, const char *host_file) {
+    // Copia el archivo origen leyendolo de a COPY_BUFFER_BLOCKS bloques
+    // Retorna 0 o -1 en caso de error
+    static uint8_t buffer[COPY_BUFFER_BLOCKS * BLOCK_SIZE];
+    ssize_t nread;
+
+    for (size_t offset = 0; (nread = read(fd, buffer, sizeof(buffer))) != 0; offset += nread) {
+
+        if (nread < 0) {
+            fprintf(stderr, "Error al leer archivo origen %s\n", host_file);
+            return -1;
+        }
+
+        if (inode_write_data(image_path, new_inode, buffer, nread, offset) != nread) {
+            fprintf(stderr, "Error al escribir datos en VFS, nodo-I nro %d, nread %zu, offset %zd.\n", new_inode, nread, offset);
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+static void remove_partial_copy(const char *image_path, const char *dest_name, int new_inode) {
+    // Deshace una copia que falló, igual que vfs-rm: quita la entrada del directorio,
+    // libera los bloques que llegaron a escribirse y después el nodo-I
+    struct inode in;
+    if (remove_dir_entry(image_path, dest_name) != 0 || read_inode(image_path, new_inode, &in) != 0 ||
+        inode_trunc_data(image_path, &in) != 0 || free_inode(image_path, new_inode) != 0) {
+        fprintf(stderr, "Error al eliminar la copia incompleta '%s' (nodo-I %d)\n", dest_name, new_inode);
+        return;
+    }
+    vfs_close(image_path);
+}
+
 // Copia un archivo del sistema anfitrión al filesystem virtual.
 int main(int argc, char *argv[]) {
     if (argc != 4) {
@@ -30,8 +89,8 @@ int main(int argc, char *argv[]) {
         return EXIT_FAILURE;
     }
 
-    // Verificar nombre válido
-    if (!name_is_valid(dest_name)) {
+    // Verificar nombre válido (puede ser una ruta dentro de la imagen)
+    if (!path_is_valid(dest_name)) {
         fprintf(stderr, "Nombre inválido: %s\n", dest_name);
         return EXIT_FAILURE;
     }
@@ -58,6 +117,21 @@ int main(int argc, char *argv[]) {
     }
 
     uint16_t perms = st.st_mode & 0777;
+
+    // Con el tamaño ya conocido, verificar antes de crear el archivo que entre en la imagen,
+    // contando los bloques de datos y los de su mapa
+    if (S_ISREG(st.st_mode)) {
+        uint64_t data_blocks = ((uint64_t)st.st_size + BLOCK_SIZE - 1) / BLOCK_SIZE;
+        uint64_t needed = data_blocks;
+        if (data_blocks <= MAX_FILE_BLOCKS)
+            needed += inode_map_blocks(data_blocks);
+        if (data_blocks > MAX_FILE_BLOCKS || needed > sb->free_blocks) {
+            fprintf(stderr, "Error: %s no entra en la imagen (%llu bloques, %u libres)\n", host_file,
+                    (unsigned long long)needed, sb->free_blocks);
+            close(fd);
+            return EXIT_FAILURE;
+        }
+    }
     
     // Crear nodo-I vacío
     int new_inode = create_empty_file_in_free_inode(image_path, perms);
@@ -67,32 +141,34 @@ int main(int argc, char *argv[]) {
         return EXIT_FAILURE;
     }
     
-    // Agregar entrada al directorio raíz
+    // Agregar entrada al directorio que corresponde
     if (add_dir_entry(image_path, dest_name, new_inode) != 0) {
         fprintf(stderr, "Error al agregar entrada de directorio para %s\n", dest_name);
+        // Si falla (por ejemplo, no existe el directorio de la ruta), libera el inodo creado
+        free_inode(image_path, new_inode);
+        close(fd);
         return EXIT_FAILURE;
     }
     
-    // Leer y escribir por bloques
-    uint8_t buffer[BLOCK_SIZE];
-    ssize_t nread;
-
-    for (size_t offset = 0; (nread = read(fd, buffer, BLOCK_SIZE)) != 0; offset += nread) {
-
-        if (nread < 0) {
-            fprintf(stderr, "Error al leer archivo origen %s\n", host_file);
-            close(fd);
-            return EXIT_FAILURE;
-        }
+    // Un archivo regular se mapea y se escribe de una vez; si no (o si no se puede
+    // mapear), se lee con un buffer grande
+    int result = 1;
+    if (S_ISREG(st.st_mode) && st.st_size > 0)
+        result = copy_mapped(image_path, new_inode, fd, st.st_size);
+    if (result > 0)
+        result = copy_read(image_path, new_inode, fd, host_file);
 
-        if (inode_write_data(image_path, new_inode, buffer, nread, offset) != nread) {
-            fprintf(stderr, "Error al escribir datos en VFS, nodo-I nro %d, nread %zu, offset %zd.\n", new_inode, nread, offset);
-            close(fd);
-            return EXIT_FAILURE;
-        }
+    close(fd);
+    if (result != 0) {
+        remove_partial_copy(image_path, dest_name, new_inode);
+        return EXIT_FAILURE;
     }
 
-    close(fd);
+    // Confirmar en la imagen los bloques que quedaron en el cache
+    if (vfs_close(image_path) != 0) {
+        fprintf(stderr, "Error al escribir los cambios en la imagen %s\n", image_path);
+        return EXIT_FAILURE;
+    }
 
     DEBUG_PRINT("Archivo copiado exitosamente como '%s' (inode %d)\n", dest_name, new_inode);
     return EXIT_SUCCESS;
@@ -0,0 +1,179 @@
+#include "vfs.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Profundidad máxima de directorios que se recorre (evita ciclos en una imagen dañada)
+#define FSCK_MAX_DEPTH 64
+
+// Contadores del recorrido
+struct fsck_counts {
+    uint32_t dirs;     // Directorios revisados
+    uint32_t entries;  // Entradas revisadas (sin contar . y ..)
+    uint32_t errors;   // Problemas encontrados
+};
+
+static void check_hidden_inode(const char *image_path, const char *path, const char *what, uint32_t *inode_nbr,
+                               struct fsck_counts *counts) {
+    // Verifica que el nodo-I oculto de la cabecera (índice, árbol o filtro) esté en uso
+    // Si no lo está, lo deja en 0 para que se vuelva a crear
+    if (*inode_nbr == 0)
+        return;
+
+    struct inode in;
+    if (read_inode(image_path, *inode_nbr, &in) != 0 || in.mode == 0) {
+        fprintf(stderr, "%s: el %s apunta al nodo-I %u, que no está en uso\n", path, what, *inode_nbr);
+        counts->errors++;
+        *inode_nbr = 0;
+    }
+}
+
+static void check_dir(const char *image_path, uint32_t dir_nbr, uint32_t parent_nbr, char *path, size_t path_len,
+                      int depth, struct fsck_counts *counts) {
+    // Revisa las entradas del directorio dir_nbr (cuya ruta está en path), baja a sus
+    // subdirectorios y después rearma su índice hash, su árbol de nombres y su filtro de Bloom
+    // (o los libera, si el directorio tiene un solo bloque)
+    struct inode dir;
+    if (read_inode(image_path, dir_nbr, &dir) != 0) {
+        fprintf(stderr, "%s: no se pudo leer el nodo-I %u\n", path, dir_nbr);
+        counts->errors++;
+        return;
+    }
+    counts->dirs++;
+
+    struct block_iter it;
+    struct block_run run;
+    uint32_t entries_found = 0;
+    int result = block_iter_init(&it, image_path, &dir, 0);
+    while (result == 0 && (result = block_iter_next(&it, 1, &run)) > 0) {
+        result = 0;
+        uint8_t buffer[BLOCK_SIZE];
+        if (read_block(image_path, run.start, buffer) != 0) {
+            result = -1;
+            break;
+        }
+
+        const struct dir_entry *entries = (const struct dir_entry *)buffer;
+        for (uint32_t j = 0; j < DIR_ENTRIES_PER_BLOCK; j++) {
+            if (entries[j].inode == 0)
+                continue;
+
+            // . apunta al directorio y .. a su padre
+            if (strcmp(entries[j].name, ".") == 0 || strcmp(entries[j].name, "..") == 0) {
+                uint32_t expected = entries[j].name[1] == '\0' ? dir_nbr : parent_nbr;
+                if (entries[j].inode != expected) {
+                    fprintf(stderr, "%s: '%s' apunta al nodo-I %u en lugar del %u\n", path, entries[j].name,
+                            entries[j].inode, expected);
+                    counts->errors++;
+                }
+                continue;
+            }
+
+            entries_found++;
+            counts->entries++;
+
+            struct inode in;
+            if (read_inode(image_path, entries[j].inode, &in) != 0 || in.mode == 0) {
+                fprintf(stderr, "%s: '%s' apunta al nodo-I %u, que no está en uso\n", path, entries[j].name,
+                        entries[j].inode);
+                counts->errors++;
+                continue;
+            }
+
+            if ((in.mode & INODE_MODE_DIR) != INODE_MODE_DIR)
+                continue;
+
+            if (depth + 1 >= FSCK_MAX_DEPTH) {
+                fprintf(stderr, "%s: demasiados niveles de directorios en '%s'\n", path, entries[j].name);
+                counts->errors++;
+                continue;
+            }
+
+            // Subdirectorio: se agrega su nombre a la ruta mientras se lo revisa
+            size_t name_len = strlen(entries[j].name);
+            memcpy(path + path_len, entries[j].name, name_len);
+            path[path_len + name_len] = '/';
+            path[path_len + name_len + 1] = '\0';
+            check_dir(image_path, entries[j].inode, dir_nbr, path, path_len + name_len + 1, depth + 1, counts);
+            path[path_len] = '\0';
+        }
+    }
+    if (result < 0) {
+        fprintf(stderr, "%s: error al recorrer los bloques del directorio\n", path);
+        counts->errors++;
+        return;
+    }
+
+    // Rearmar las estructuras auxiliares con las entradas actuales
+    struct dir_header hdr;
+    int has_header = dir_header_read(image_path, dir_nbr, &dir, &hdr);
+    if (has_header < 0) {
+        fprintf(stderr, "%s: no se pudo leer la cabecera del directorio\n", path);
+        counts->errors++;
+        return;
+    }
+    if (!has_header) {
+        printf("%s: %u entradas, sin cabecera (imagen anterior): no se rearman sus índices\n", path, entries_found);
+        return;
+    }
+
+    // Los nodos-I ocultos de la cabecera tienen que estar en uso; si no, se olvidan
+    check_hidden_inode(image_path, path, "índice hash", &hdr.index_inode, counts);
+    check_hidden_inode(image_path, path, "árbol de nombres", &hdr.tree_inode, counts);
+    check_hidden_inode(image_path, path, "filtro de Bloom", &hdr.bloom_inode, counts);
+
+    // Un directorio de un solo bloque no los necesita (ver update_header): se liberan
+    if (dir.blocks <= 1) {
+        dir_hash_drop(image_path, &hdr);
+        dir_tree_drop(image_path, &hdr);
+        dir_bloom_drop(image_path, &hdr);
+        if (dir_header_write(image_path, &dir, &hdr) != 0) {
+            fprintf(stderr, "%s: no se pudo escribir la cabecera del directorio\n", path);
+            counts->errors++;
+            return;
+        }
+        printf("%s: %u entradas, un bloque (sin índices)\n", path, entries_found);
+        return;
+    }
+
+    if (dir_hash_build(image_path, &dir, &hdr) != 0 || dir_tree_build(image_path, &dir, &hdr) != 0 ||
+        dir_bloom_build(image_path, &dir, &hdr) != 0 || dir_header_write(image_path, &dir, &hdr) != 0) {
+        fprintf(stderr, "%s: no se pudieron rearmar los índices del directorio\n", path);
+        counts->errors++;
+        return;
+    }
+
+    printf("%s: %u entradas, índices rearmados\n", path, entries_found);
+}
+
+// Este programa revisa los directorios de la imagen desde la raíz y rearma sus índices
+int main(int argc, char *argv[]) {
+    // Verifica que se pase la imagen como argumento
+    if (argc != 2) {
+        fprintf(stderr, "Uso: %s imagen\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    const char *image_path = argv[1];
+
+    // Valida y carga el superbloque de la imagen
+    struct superblock sb;
+    if (read_superblock(image_path, &sb) != 0) {
+        perror("Error al leer el superbloque");
+        return EXIT_FAILURE;
+    }
+
+    char path[FSCK_MAX_DEPTH * FILENAME_MAX_LEN + 2] = "/";
+    struct fsck_counts counts = {0, 0, 0};
+    check_dir(image_path, ROOTDIR_INODE, ROOTDIR_INODE, path, 1, 0, &counts);
+
+    printf("%u directorios, %u entradas, %u errores\n", counts.dirs, counts.entries, counts.errors);
+
+    // Confirmar en la imagen los bloques que quedaron en el cache
+    if (vfs_close(image_path) != 0) {
+        fprintf(stderr, "Error al escribir los cambios en la imagen %s\n", image_path);
+        return EXIT_FAILURE;
+    }
+
+    return counts.errors == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -16,6 +16,8 @@ int main(int argc, char *argv[])
 
     const char *image_path = argv[1];
     struct superblock sb_struct;
+
+    vfs_set_backend(VFS_BACKEND_MMAP);
     
     if (read_superblock(image_path, &sb_struct) != 0) {
         fprintf(stderr, "Error al leer superblock\n");
@@ -29,13 +31,19 @@ int main(int argc, char *argv[])
     uint32_t to_print = sb_struct.total_blocks;
     for (uint32_t i = 0; i < sb_struct.bitmap_blocks; i++)
     {
-        if (read_block(image_path, sb_struct.bitmap_start + i, buffer) != 0)
+        // Si la imagen esta mapeada se imprime directamente desde el mapeo
+        const uint8_t *bitmap = block_ptr(image_path, sb_struct.bitmap_start + i);
+        if (bitmap == NULL)
         {
-            fprintf(stderr, "Error al leer bloque de bitmap %u\n", i);
-            return EXIT_FAILURE;
+            if (read_block(image_path, sb_struct.bitmap_start + i, buffer) != 0)
+            {
+                fprintf(stderr, "Error al leer bloque de bitmap %u\n", i);
+                return EXIT_FAILURE;
+            }
+            bitmap = buffer;
         }
 
-        print_bitmap_block(buffer, to_print < BLOCK_SIZE ? to_print : BLOCK_SIZE);
+        print_bitmap_block((uint8_t *)bitmap, to_print < BLOCK_SIZE ? to_print : BLOCK_SIZE);
         to_print -= BLOCK_SIZE;
     }
 
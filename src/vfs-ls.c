@@ -5,15 +5,136 @@
 
 #include "vfs.h"
 
-// Este programa lista los archivos del directorio raíz al estilo ls -l
+static int list_prefix_tree(const char *image_path, const struct dir_header *hdr, const char *prefix) {
+    // Lista en orden de nombre las entradas que empiezan con prefix: baja una vez por el
+    // árbol de nombres hasta la primera y recorre las hojas hasta la primera que no empieza
+    // con prefix. Retorna EXIT_SUCCESS o EXIT_FAILURE
+    size_t prefix_len = strlen(prefix);
+    struct dir_tree_iter it;
+    if (dir_tree_iter_init(&it, image_path, hdr, prefix) != 0) {
+        fprintf(stderr, "Error al leer el árbol de nombres del directorio\n");
+        return EXIT_FAILURE;
+    }
+
+    int result;
+    do {
+        struct dir_entry entries[DIR_ENTRIES_PER_BLOCK];
+        uint32_t inode_nbrs[DIR_ENTRIES_PER_BLOCK];
+        uint32_t count = 0;
+
+        while (count < DIR_ENTRIES_PER_BLOCK && (result = dir_tree_iter_next(&it, &entries[count])) > 0) {
+            if (strncmp(entries[count].name, prefix, prefix_len) != 0) {
+                result = 0; // Se pasó del rango del prefijo
+                break;
+            }
+            inode_nbrs[count] = entries[count].inode;
+            count++;
+        }
+        if (result < 0) {
+            fprintf(stderr, "Error al leer el árbol de nombres del directorio\n");
+            return EXIT_FAILURE;
+        }
+
+        // Lee los inodos de la tanda juntos, recorriendo la tabla de nodos-I en orden
+        struct inode inodes[DIR_ENTRIES_PER_BLOCK];
+        if (read_inodes(image_path, inode_nbrs, inodes, count) != 0) {
+            fprintf(stderr, "Error al leer los inodos del directorio\n");
+            return EXIT_FAILURE;
+        }
+        for (uint32_t k = 0; k < count; k++) {
+            if (inodes[k].mode == 0) continue; // Nodo-I inválido, read_inodes ya lo informó
+            print_inode(&inodes[k], inode_nbrs[k], entries[k].name);
+        }
+    } while (result > 0);
+
+    return EXIT_SUCCESS;
+}
+
+static int compare_entry_names(const void *a, const void *b) {
+    return strcmp(((const struct dir_entry *)a)->name, ((const struct dir_entry *)b)->name);
+}
+
+static int collect_prefix(const char *image_path, struct inode *dir_inode, const char *prefix,
+                          struct dir_entry *matches, uint32_t *count) {
+    // Deja en matches las entradas del directorio que empiezan con prefix, en orden de
+    // directorio, y en count su cantidad. Retorna 0 o -1 en caso de error
+    size_t prefix_len = strlen(prefix);
+    struct block_iter it;
+    struct block_run run;
+    if (block_iter_init(&it, image_path, dir_inode, 0) != 0)
+        return -1;
+
+    int result;
+    *count = 0;
+    while ((result = block_iter_next(&it, 1, &run)) > 0) {
+        struct dir_entry entry[DIR_ENTRIES_PER_BLOCK];
+        if (read_block(image_path, run.start, entry) != 0)
+            return -1;
+        for (uint32_t i = 0; i < DIR_ENTRIES_PER_BLOCK; i++) {
+            if (entry[i].inode == 0) continue; // Entrada vacía
+            if (strncmp(entry[i].name, prefix, prefix_len) != 0) continue;
+            matches[(*count)++] = entry[i];
+        }
+    }
+    return result < 0 ? -1 : 0;
+}
+
+static int list_prefix_unsorted(const char *image_path, struct inode *dir_inode, const char *prefix) {
+    // Directorio sin árbol de nombres (de un solo bloque, o de una imagen vieja): junta las
+    // entradas que empiezan con prefix, las ordena por nombre y lee sus inodos juntos
+    // Retorna EXIT_SUCCESS o EXIT_FAILURE
+    size_t max_entries = (size_t)DIR_ENTRIES_PER_BLOCK * dir_inode->blocks;
+    struct dir_entry *matches = malloc(max_entries * sizeof(struct dir_entry));
+    uint32_t *inode_nbrs = malloc(max_entries * sizeof(uint32_t));
+    struct inode *inodes = malloc(max_entries * sizeof(struct inode));
+    uint32_t count = 0;
+    int result = EXIT_FAILURE;
+
+    if (matches == NULL || inode_nbrs == NULL || inodes == NULL)
+        fprintf(stderr, "Sin memoria para listar el directorio\n");
+    else if (collect_prefix(image_path, dir_inode, prefix, matches, &count) != 0)
+        fprintf(stderr, "Error al leer los bloques de datos del directorio\n");
+    else {
+        qsort(matches, count, sizeof(struct dir_entry), compare_entry_names);
+
+        // Lee todos los inodos juntos, recorriendo la tabla de nodos-I en orden
+        for (uint32_t k = 0; k < count; k++)
+            inode_nbrs[k] = matches[k].inode;
+        if (read_inodes(image_path, inode_nbrs, inodes, count) == 0) {
+            for (uint32_t k = 0; k < count; k++) {
+                if (inodes[k].mode == 0) continue; // Nodo-I inválido, read_inodes ya lo informó
+                print_inode(&inodes[k], inode_nbrs[k], matches[k].name);
+            }
+            result = EXIT_SUCCESS;
+        } else
+            fprintf(stderr, "Error al leer los inodos del directorio\n");
+    }
+
+    free(matches);
+    free(inode_nbrs);
+    free(inodes);
+    return result;
+}
+
+// Este programa lista los archivos del directorio al estilo ls -l
+// Con --prefix, solo los que empiezan con el prefijo, en orden de nombre
 int main(int argc, char *argv[]) {
     // Verifica que se pase la imagen como argumento
-    if (argc != 2) {
-        fprintf(stderr, "Uso: %s imagen\n", argv[0]);
+    const char *prefix = NULL;
+    int arg = 1;
+    if (argc > 2 && strcmp(argv[1], "--prefix") == 0) {
+        prefix = argv[2];
+        arg = 3;
+    }
+    if (argc - arg < 1 || argc - arg > 2) {
+        fprintf(stderr, "Uso: %s [--prefix <prefijo>] imagen [directorio]\n", argv[0]);
         return EXIT_FAILURE;
     }
 
-    const char *image_path = argv[1];
+    const char *image_path = argv[arg];
+    const char *dir_path = argc - arg == 2 ? argv[arg + 1] : "/";
+
+    vfs_set_backend(VFS_BACKEND_MMAP);
 
     // Lee el superbloque para saber la cantidad de inodos
     struct superblock sb;
@@ -22,41 +143,82 @@ int main(int argc, char *argv[]) {
         return EXIT_FAILURE;
     }
 
-    // Lee el inodo del directorio raíz (siempre es el inodo 1)
-    struct inode root_inode;
-    if (read_inode(image_path, 1, &root_inode) != 0) {
-        fprintf(stderr, "Error al leer el inodo del directorio raíz\n");
+    // Busca el directorio a listar (por defecto la raíz) y lee su inodo
+    int dir_nbr = dir_lookup(image_path, dir_path);
+    if (dir_nbr <= 0) {
+        fprintf(stderr, "Directorio '%s' no encontrado\n", dir_path);
         return EXIT_FAILURE;
     }
-
-    // Lee el bloque de datos del directorio raíz
-    uint8_t buffer[BLOCK_SIZE];
-    int data_block = get_block_number_at(image_path, &root_inode, 0);
-    if (data_block < 0) {
-        fprintf(stderr, "Error al obtener el bloque de datos del directorio raíz\n");
+    struct inode dir_inode;
+    if (read_inode(image_path, dir_nbr, &dir_inode) != 0) {
+        fprintf(stderr, "Error al leer el inodo del directorio\n");
         return EXIT_FAILURE;
     }
-    if (read_block(image_path, data_block, buffer) != 0) {
-        fprintf(stderr, "Error al leer el bloque de datos del directorio raíz\n");
+    if ((dir_inode.mode & INODE_MODE_DIR) != INODE_MODE_DIR) {
+        fprintf(stderr, "'%s' no es un directorio\n", dir_path);
         return EXIT_FAILURE;
     }
 
-    // Recorre todas las entradas de directorio y muestra la información estilo ls -l
-    struct dir_entry *entry = (struct dir_entry *)buffer;
-    int entries = BLOCK_SIZE / sizeof(struct dir_entry);
+    // Con prefijo, si el directorio tiene árbol de nombres se lee solo el rango pedido;
+    // si no, se recorre entero, se filtra y se ordena
+    if (prefix != NULL) {
+        struct dir_header hdr;
+        int has_header = dir_header_read(image_path, dir_nbr, &dir_inode, &hdr);
+        if (has_header < 0) {
+            fprintf(stderr, "Error al leer la cabecera del directorio\n");
+            return EXIT_FAILURE;
+        }
+        if (has_header && hdr.tree_inode != 0)
+            return list_prefix_tree(image_path, &hdr, prefix);
+        return list_prefix_unsorted(image_path, &dir_inode, prefix);
+    }
 
-    for (int i = 0; i < entries; i++) {
-        if (entry[i].inode == 0) continue; // Entrada vacía
+    // Recorre los bloques del directorio en orden
+    struct block_iter it;
+    struct block_run run;
+    if (block_iter_init(&it, image_path, &dir_inode, 0) != 0) {
+        fprintf(stderr, "Error al obtener el bloque de datos del directorio\n");
+        return EXIT_FAILURE;
+    }
+
+    int result;
+    while ((result = block_iter_next(&it, 1, &run)) > 0) {
+        uint8_t buffer[BLOCK_SIZE];
+        if (read_block(image_path, run.start, buffer) != 0) {
+            fprintf(stderr, "Error al leer el bloque de datos del directorio\n");
+            return EXIT_FAILURE;
+        }
+
+        // Junta los números de nodo-I de las entradas usadas del bloque
+        struct dir_entry *entry = (struct dir_entry *)buffer;
+        int entries = BLOCK_SIZE / sizeof(struct dir_entry);
+        uint32_t inode_nbrs[BLOCK_SIZE / sizeof(struct dir_entry)];
+        int used[BLOCK_SIZE / sizeof(struct dir_entry)];
+        uint32_t count = 0;
+
+        for (int i = 0; i < entries; i++) {
+            if (entry[i].inode == 0) continue; // Entrada vacía
+            used[count] = i;
+            inode_nbrs[count++] = entry[i].inode;
+        }
 
-        // Lee el inodo del archivo
-        struct inode in;
-        if (read_inode(image_path, entry[i].inode, &in) != 0) {
-            fprintf(stderr, "Error al leer inodo %d\n", entry[i].inode);
-            continue;
+        // Lee todos los inodos del bloque juntos, recorriendo la tabla de nodos-I en orden
+        struct inode inodes[BLOCK_SIZE / sizeof(struct dir_entry)];
+        if (read_inodes(image_path, inode_nbrs, inodes, count) != 0) {
+            fprintf(stderr, "Error al leer los inodos del directorio\n");
+            return EXIT_FAILURE;
         }
 
-        // Muestra los datos estilo ls -l
-        print_inode(&in, entry[i].inode, entry[i].name);
+        // Muestra la información estilo ls -l, en el orden del directorio
+        for (uint32_t k = 0; k < count; k++) {
+            if (inodes[k].mode == 0) continue; // Nodo-I inválido, read_inodes ya lo informó
+            print_inode(&inodes[k], inode_nbrs[k], entry[used[k]].name);
+        }
+    }
+
+    if (result < 0) {
+        fprintf(stderr, "Error al obtener el bloque de datos del directorio\n");
+        return EXIT_FAILURE;
     }
 
     return EXIT_SUCCESS;
@@ -17,54 +17,145 @@ int compare_entries(const void *a, const void *b) {
     return strcmp(fa->name, fb->name);
 }
 
-int main(int argc, char *argv[]) {
-    // Verifica que se pase la imagen como argumento
-    if (argc != 2) {
-        fprintf(stderr, "Uso: %s <imagen>\n", argv[0]);
+static int list_unsorted_dir(const char *image_path, struct inode *dir_inode) {
+    // Directorio sin arbol de nombres (imagen vieja): junta todas las entradas y las ordena
+    // Retorna 0 o 1 en caso de error
+    // Las entradas van al heap: un directorio grande no entra en la pila
+    size_t max_entries = (size_t)DIR_ENTRIES_PER_BLOCK * dir_inode->blocks;
+    struct file_entry *files = malloc(max_entries * sizeof(struct file_entry));
+    uint32_t *inode_nbrs = malloc(max_entries * sizeof(uint32_t));
+    struct inode *inodes = malloc(max_entries * sizeof(struct inode));
+    int file_count = 0;
+    int result = 1;
+
+    if (files == NULL || inode_nbrs == NULL || inodes == NULL) {
+        fprintf(stderr, "Sin memoria para listar el directorio\n");
+        free(files);
+        free(inode_nbrs);
+        free(inodes);
         return 1;
     }
 
-    const char *image_path = argv[1];
-    struct inode root_inode;
-
-    // Lee el inodo del directorio raíz
-    if (read_inode(image_path, ROOTDIR_INODE, &root_inode) != 0) {
-        fprintf(stderr, "No se pudo leer el directorio raíz\n");
+    struct block_iter it;
+    struct block_run run;
+    if (block_iter_init(&it, image_path, dir_inode, 0) != 0) {
+        fprintf(stderr, "No se pudo leer el mapa de bloques del directorio\n");
+        free(files);
+        free(inode_nbrs);
+        free(inodes);
         return 1;
     }
 
-    // Recorre todos los bloques del directorio raíz y almacena las entradas válidas
-    struct file_entry files[DIR_ENTRIES_PER_BLOCK * root_inode.blocks];
-    int file_count = 0;
-
-    for (int i = 0; i < root_inode.blocks; i++) {
-        int block_num = get_block_number_at(image_path, &root_inode, i);
-        if (block_num <= 0) continue;
-
+    while (block_iter_next(&it, 1, &run) > 0) {
         uint8_t data_buf[BLOCK_SIZE];
-        if (read_block(image_path, block_num, data_buf) != 0) continue;
+        if (read_block(image_path, run.start, data_buf) != 0) continue;
 
         struct dir_entry *entries = (struct dir_entry *)data_buf;
-        for (int j = 0; j < DIR_ENTRIES_PER_BLOCK; j++) {
+        for (uint32_t j = 0; j < DIR_ENTRIES_PER_BLOCK; j++) {
             if (entries[j].inode == 0) continue; // Entrada vacía
 
-            // Lee el inodo y almacena la información en el array auxiliar
-            if (read_inode(image_path, entries[j].inode, &files[file_count].in) == 0) {
-                strncpy(files[file_count].name, entries[j].name, FILENAME_MAX_LEN);
-                files[file_count].inode_nbr = entries[j].inode;
-                file_count++;
-            }
+            strncpy(files[file_count].name, entries[j].name, FILENAME_MAX_LEN);
+            files[file_count].inode_nbr = inode_nbrs[file_count] = entries[j].inode;
+            file_count++;
         }
     }
 
-    // Ordena las entradas alfabéticamente por nombre
-    qsort(files, file_count, sizeof(struct file_entry), compare_entries);
+    // Lee todos los inodos juntos, recorriendo la tabla de nodos-I en orden
+    if (read_inodes(image_path, inode_nbrs, inodes, file_count) == 0) {
+        // Descarta las entradas con nodo-I inválido (read_inodes ya las informó)
+        int kept = 0;
+        for (int i = 0; i < file_count; i++) {
+            if (inodes[i].mode == 0) continue;
+            files[kept] = files[i];
+            files[kept++].in = inodes[i];
+        }
+        file_count = kept;
+
+        // Ordena las entradas alfabéticamente por nombre
+        qsort(files, file_count, sizeof(struct file_entry), compare_entries);
 
-    // Imprime la información de cada archivo ordenado
-    for (int i = 0; i < file_count; i++) {
-        print_inode(&files[i].in, files[i].inode_nbr, files[i].name);
+        // Imprime la información de cada archivo ordenado
+        for (int i = 0; i < file_count; i++) {
+            print_inode(&files[i].in, files[i].inode_nbr, files[i].name);
+        }
+        result = 0;
+    } else {
+        fprintf(stderr, "No se pudieron leer los inodos del directorio\n");
     }
 
-    return 0;
+    free(files);
+    free(inode_nbrs);
+    free(inodes);
+    return result;
 }
 
+int main(int argc, char *argv[]) {
+    // Verifica que se pase la imagen como argumento
+    if (argc != 2 && argc != 3) {
+        fprintf(stderr, "Uso: %s <imagen> [directorio]\n", argv[0]);
+        return 1;
+    }
+
+    const char *image_path = argv[1];
+    const char *dir_path = argc == 3 ? argv[2] : "/";
+
+    vfs_set_backend(VFS_BACKEND_MMAP);
+    struct inode dir_inode;
+
+    // Busca el directorio a listar (por defecto la raíz) y lee su inodo
+    int dir_nbr = dir_lookup(image_path, dir_path);
+    if (dir_nbr <= 0 || read_inode(image_path, dir_nbr, &dir_inode) != 0) {
+        fprintf(stderr, "No se pudo leer el directorio '%s'\n", dir_path);
+        return 1;
+    }
+    if ((dir_inode.mode & INODE_MODE_DIR) != INODE_MODE_DIR) {
+        fprintf(stderr, "'%s' no es un directorio\n", dir_path);
+        return 1;
+    }
+
+    struct dir_header hdr;
+    int has_header = dir_header_read(image_path, dir_nbr, &dir_inode, &hdr);
+    if (has_header < 0) {
+        fprintf(stderr, "No se pudo leer la cabecera del directorio\n");
+        return 1;
+    }
+    if (!has_header || hdr.tree_inode == 0)
+        return list_unsorted_dir(image_path, &dir_inode);
+
+    // Recorre las hojas del árbol de nombres, que ya están en orden: de a tandas de
+    // DIR_ENTRIES_PER_BLOCK entradas, con memoria fija sin importar el tamaño del directorio
+    struct dir_tree_iter it;
+    if (dir_tree_iter_init(&it, image_path, &hdr, NULL) != 0) {
+        fprintf(stderr, "No se pudo leer el árbol de nombres del directorio\n");
+        return 1;
+    }
+
+    int result;
+    do {
+        struct dir_entry entries[DIR_ENTRIES_PER_BLOCK];
+        uint32_t inode_nbrs[DIR_ENTRIES_PER_BLOCK];
+        uint32_t count = 0;
+
+        while (count < DIR_ENTRIES_PER_BLOCK && (result = dir_tree_iter_next(&it, &entries[count])) > 0) {
+            inode_nbrs[count] = entries[count].inode;
+            count++;
+        }
+        if (result < 0) {
+            fprintf(stderr, "No se pudo leer el árbol de nombres del directorio\n");
+            return 1;
+        }
+
+        // Lee los inodos de la tanda juntos, recorriendo la tabla de nodos-I en orden
+        struct inode inodes[DIR_ENTRIES_PER_BLOCK];
+        if (read_inodes(image_path, inode_nbrs, inodes, count) != 0) {
+            fprintf(stderr, "No se pudieron leer los inodos del directorio\n");
+            return 1;
+        }
+        for (uint32_t i = 0; i < count; i++) {
+            if (inodes[i].mode == 0) continue; // Nodo-I inválido, read_inodes ya lo informó
+            print_inode(&inodes[i], inode_nbrs[i], entries[i].name);
+        }
+    } while (result > 0);
+
+    return 0;
+}
@@ -0,0 +1,74 @@
+#include "vfs.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Este programa crea directorios vacíos en el sistema de archivos virtual
+int main(int argc, char *argv[]) {
+    // Verifica que se pase la imagen y al menos un directorio como argumento
+    if (argc < 3) {
+        fprintf(stderr, "Uso: %s imagen directorio1 [directorio2...]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    const char *image_path = argv[1];
+
+    // Valida y carga el superbloque de la imagen
+    struct superblock sb;
+    if (read_superblock(image_path, &sb) != 0) {
+        perror("Error al leer el superbloque");
+        return EXIT_FAILURE;
+    }
+
+    // Recorre cada directorio solicitado para crear
+    for (int i = 2; i < argc; i++) {
+        const char *path = argv[i];
+
+        // Valida la ruta del directorio
+        if (!path_is_valid(path)) {
+            fprintf(stderr, "Nombre inválido: %s\n", path);
+            continue;
+        }
+
+        // Verifica si ya existe algo con ese nombre
+        int existing_inode = dir_lookup(image_path, path);
+        if (existing_inode > 0) {
+            fprintf(stderr, "Ya existe un archivo con el nombre: %s\n", path);
+            continue;
+        }
+
+        // Busca el directorio padre, que tiene que existir
+        uint32_t parent;
+        char name[FILENAME_MAX_LEN];
+        if (dir_resolve(image_path, path, &parent, name) != 1) {
+            fprintf(stderr, "No existe el directorio padre de: %s\n", path);
+            continue;
+        }
+
+        // Crea el directorio, con . y .., en un inodo libre
+        int new_inode = create_dir(image_path, parent, 0755);
+        if (new_inode < 0) {
+            fprintf(stderr, "Error al crear el directorio: %s\n", path);
+            continue;
+        }
+
+        // Agrega la entrada al directorio padre
+        if (add_dir_entry(image_path, path, new_inode) != 0) {
+            fprintf(stderr, "Error al agregar %s al directorio\n", path);
+            // Si falla, libera el directorio creado
+            free_dir(image_path, new_inode);
+            continue;
+        }
+
+        // Confirma la creación
+        printf("Directorio '%s' creado exitosamente (inodo %d)\n", path, new_inode);
+    }
+
+    // Confirmar en la imagen los bloques que quedaron en el cache
+    if (vfs_close(image_path) != 0) {
+        fprintf(stderr, "Error al escribir los cambios en la imagen %s\n", image_path);
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -17,10 +17,34 @@ static uint32_t round_up_inodes(uint32_t count) {
         Bloques 1 a N: area de nodos-I, el nodo-I 0 no se usa, el 1 es el directorio raiz
         Bloques N+1 a B: area de bitmap de bloques ocupados/libres
         Bloque B+1: directorio raiz (unico), solo con entradas . y ..
+
+    Con --no-zero la imagen queda dispersa: no se reserva espacio en disco para los bloques
+    Con --atime=<politica> se elige cuándo las lecturas actualizan el atime
+    (strict, relatime, noatime o lazytime; por defecto strict)
 */
 int main(int argc, char *argv[]) {
+    const char *prog = argv[0];
+    int sparse = 0;
+    int atime_policy = VFS_ATIME_STRICT;
+
+    while (argc > 1 && strncmp(argv[1], "--", 2) == 0) {
+        if (strcmp(argv[1], "--no-zero") == 0)
+            sparse = 1;
+        else if (strncmp(argv[1], "--atime=", 8) == 0) {
+            atime_policy = atime_policy_from_name(argv[1] + 8);
+            if (atime_policy < 0) {
+                fprintf(stderr, "Error: politica de atime desconocida '%s'\n", argv[1] + 8);
+                return EXIT_FAILURE;
+            }
+        } else
+            break;
+        argc--;
+        argv++;
+    }
+
     if (argc != 4) {
-        fprintf(stderr, "Uso: %s <nombre_imagen> <total_bloques> <cantidad_nodosI>\n", argv[0]);
+        fprintf(stderr, "Uso: %s [--no-zero] [--atime=strict|relatime|noatime|lazytime] <nombre_imagen> "
+                        "<total_bloques> <cantidad_nodosI>\n", prog);
         return EXIT_FAILURE;
     }
 
@@ -40,7 +64,7 @@ int main(int argc, char *argv[]) {
     }
 
     errno = 0;
-    int result = create_block_device(image_path, total_blocks, BLOCK_SIZE);
+    int result = create_block_device(image_path, total_blocks, BLOCK_SIZE, sparse);
     if (result != 0) {
         fprintf(stderr, "Error al crear el dispositivo de bloques: %s\n", strerror(errno));
         return EXIT_FAILURE;
@@ -55,11 +79,27 @@ int main(int argc, char *argv[]) {
         return EXIT_FAILURE;
     }
 
+    struct superblock sb;
+    if (read_superblock(image_path, &sb) != 0) {
+        fprintf(stderr, "Error: no se pudo leer el superbloque\n");
+        return EXIT_FAILURE;
+    }
+    sb.atime_policy = atime_policy;
+    if (write_superblock(image_path, &sb) != 0) {
+        fprintf(stderr, "Error: no se pudo guardar la politica de atime\n");
+        return EXIT_FAILURE;
+    }
+
     if (create_root_dir(image_path) != 0) {
         fprintf(stderr, "Error: no se pudo crear el directorio raíz\n");
         return EXIT_FAILURE;
     }
 
+    if (vfs_close(image_path) != 0) {
+        fprintf(stderr, "Error: no se pudo escribir la imagen\n");
+        return EXIT_FAILURE;
+    }
+
     fprintf(stderr, "Dispositivo de bloques inicializado exitosamente: %s\n", image_path);
 
     return EXIT_SUCCESS;
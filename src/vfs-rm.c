@@ -17,8 +17,8 @@ int main(int argc, char *argv[]) {
     for (int i = 2; i < argc; i++) {
         const char *filename = argv[i];
 
-        // Valida el nombre del archivo
-        if (!name_is_valid(filename)) {
+        // Valida el nombre del archivo (puede ser una ruta dentro de la imagen)
+        if (!path_is_valid(filename)) {
             fprintf(stderr, "Nombre inválido: %s\n", filename);
             continue;
         }
@@ -30,13 +30,29 @@ int main(int argc, char *argv[]) {
             continue;
         }
 
+        // Solo borra archivos regulares
+        struct inode in;
+        if (read_inode(image_path, inode_nbr, &in) != 0) {
+            fprintf(stderr, "Error al leer el inodo de %s\n", filename);
+            continue;
+        }
+        if ((in.mode & INODE_MODE_DIR) == INODE_MODE_DIR) {
+            fprintf(stderr, "Es un directorio: %s\n", filename);
+            continue;
+        }
+
         // Elimina la entrada del directorio
         if (remove_dir_entry(image_path, filename) != 0) {
             fprintf(stderr, "Error al eliminar entrada de directorio: %s\n", filename);
             continue;
         }
 
-        // Libera el inodo asociado
+        // Libera los bloques de datos del archivo y después el inodo asociado
+        if (inode_trunc_data(image_path, &in) != 0) {
+            fprintf(stderr, "Error al liberar los bloques de archivo %s\n", filename);
+            continue;
+        }
+
         if (free_inode(image_path, inode_nbr) != 0) {
             fprintf(stderr, "Error al liberar inodo %d de archivo %s\n", inode_nbr, filename);
             continue;
@@ -46,6 +62,12 @@ int main(int argc, char *argv[]) {
         printf("Archivo '%s' eliminado correctamente (inodo %d)\n", filename, inode_nbr);
     }
 
+    // Confirmar en la imagen los bloques que quedaron en el cache
+    if (vfs_close(image_path) != 0) {
+        fprintf(stderr, "Error al escribir los cambios en la imagen %s\n", image_path);
+        return EXIT_FAILURE;
+    }
+
     return EXIT_SUCCESS;
 }
 
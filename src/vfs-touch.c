@@ -24,8 +24,8 @@ int main(int argc, char *argv[]) {
     for (int i = 2; i < argc; i++) {
         const char *filename = argv[i];
 
-        // Valida el nombre del archivo
-        if (!name_is_valid(filename)) {
+        // Valida el nombre del archivo (puede ser una ruta dentro de la imagen)
+        if (!path_is_valid(filename)) {
             fprintf(stderr, "Nombre inválido: %s\n", filename);
             continue;
         }
@@ -44,7 +44,7 @@ int main(int argc, char *argv[]) {
             continue;
         }
 
-        // Agrega la entrada al directorio raíz
+        // Agrega la entrada al directorio que corresponde
         if (add_dir_entry(image_path, filename, new_inode) != 0) {
             fprintf(stderr, "Error al agregar %s al directorio\n", filename);
             // Si falla, libera el inodo creado
@@ -56,6 +56,12 @@ int main(int argc, char *argv[]) {
         printf("Archivo '%s' creado exitosamente (inodo %d)\n", filename, new_inode);
     }
 
+    // Confirmar en la imagen los bloques que quedaron en el cache
+    if (vfs_close(image_path) != 0) {
+        fprintf(stderr, "Error al escribir los cambios en la imagen %s\n", image_path);
+        return EXIT_FAILURE;
+    }
+
     return EXIT_SUCCESS;
 }
 
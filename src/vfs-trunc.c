@@ -40,17 +40,13 @@ int main(int argc, char *argv[]) {
             continue;
         }
 
-        // Libera todos los bloques de datos asociados al archivo
-        for (uint16_t j = 0; j < in.blocks; j++) {
-            int block_nbr = get_block_number_at(image_path, &in, j);
-            if (block_nbr > 0) {
-                bitmap_free_block(image_path, block_nbr);
-            }
+        // Libera todos los bloques de datos (incluido el indirecto) y deja el archivo
+        // vacío, con tamaño y bloques en cero
+        if (inode_trunc_data(image_path, &in) != 0) {
+            fprintf(stderr, "No se pudieron liberar los bloques de '%s'\n", filename);
+            continue;
         }
 
-        // Deja el archivo vacío (tamaño y bloques en cero)
-        in.size = 0;
-        in.blocks = 0;
         if (write_inode(image_path, inode_number, &in) != 0) {
             fprintf(stderr, "No se pudo escribir el inodo truncado de '%s'\n", filename);
             continue;
@@ -59,6 +55,12 @@ int main(int argc, char *argv[]) {
         printf("Archivo '%s' truncado exitosamente.\n", filename);
     }
 
+    // Confirmar en la imagen los bloques que quedaron en el cache
+    if (vfs_close(image_path) != 0) {
+        fprintf(stderr, "Error al escribir los cambios en la imagen %s\n", image_path);
+        return 1;
+    }
+
     return 0;
 }
 